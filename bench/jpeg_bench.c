@@ -0,0 +1,196 @@
+// Verificación y benchmark del codificador y decodificador JPEG paralelos por franjas
+// Uso: jpeg_bench [megapixeles] [hilos]
+#include "jpeg_encoder.h"
+#include "jpeg_decoder.h"
+#include "thread_pool.h"
+#include "buffer_pool.h"
+#include "stb/stb_image.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define DEFAULT_MEGAPIXELS 12
+#define QUALITY 90
+// Por encima de 90 stb no submuestrea el croma (MCU de 8x8, sin interpolación vertical)
+#define QUALITY_444 95
+
+typedef struct
+{
+    unsigned char *data;
+    size_t size;
+    size_t capacity;
+} output_buffer_t;
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void append_bytes(void *context, void *data, int size)
+{
+    output_buffer_t *out = (output_buffer_t *)context;
+    if (out->size + (size_t)size > out->capacity)
+    {
+        out->capacity = (out->size + (size_t)size) * 2;
+        out->data = realloc(out->data, out->capacity);
+        if (!out->data)
+        {
+            perror("realloc");
+            exit(1);
+        }
+    }
+    memcpy(out->data + out->size, data, (size_t)size);
+    out->size += (size_t)size;
+}
+
+// Degradado con ruido: comprime como una foto y no como un color plano
+static unsigned char *make_image(int width, int height, int channels)
+{
+    unsigned char *image = malloc((size_t)width * height * channels);
+    unsigned int seed = 12345;
+    if (!image)
+    {
+        perror("malloc");
+        exit(1);
+    }
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            unsigned char *p = image + ((size_t)y * width + x) * channels;
+            for (int c = 0; c < channels; c++)
+            {
+                seed = seed * 1103515245 + 12345;
+                p[c] = (unsigned char)(((x * (c + 1) + y * (3 - c)) / 8 + ((seed >> 16) & 15)) & 0xFF);
+            }
+        }
+    }
+    return image;
+}
+
+// Decodifica ambas salidas: las franjas solo agregan reinicios, los pixeles
+// decodificados deben ser idénticos a los del codificador secuencial
+static int verify(int width, int height, int channels)
+{
+    unsigned char *image = make_image(width, height, channels);
+    output_buffer_t sequential = {0}, parallel = {0};
+    int ok = 0;
+
+    if (stbi_write_jpg_to_func(append_bytes, &sequential, width, height, channels, image, QUALITY) &&
+        parallel_jpeg_write_to_func(append_bytes, &parallel, width, height, channels, image, QUALITY))
+    {
+        int w1, h1, c1, w2, h2, c2;
+        unsigned char *a = stbi_load_from_memory(sequential.data, (int)sequential.size, &w1, &h1, &c1, 0);
+        unsigned char *b = stbi_load_from_memory(parallel.data, (int)parallel.size, &w2, &h2, &c2, 0);
+        ok = a && b && w1 == w2 && h1 == h2 && c1 == c2 && memcmp(a, b, (size_t)w1 * h1 * c1) == 0;
+        stbi_image_free(a);
+        stbi_image_free(b);
+    }
+
+    printf("  codificar %5dx%-5d %d canales: %s\n", width, height, channels, ok ? "OK" : "FALLA");
+    free(sequential.data);
+    free(parallel.data);
+    free(image);
+    return ok;
+}
+
+// Un JPEG con reinicios decodificado por franjas debe dar los mismos pixeles
+// que stbi_load_from_memory, también pidiendo otro número de canales
+static int verify_decode(int width, int height, int channels, int quality, int req_channels)
+{
+    unsigned char *image = make_image(width, height, channels);
+    output_buffer_t jpeg = {0};
+    int ok = 0;
+
+    if (parallel_jpeg_write_to_func(append_bytes, &jpeg, width, height, channels, image, quality))
+    {
+        int w1, h1, c1, w2, h2, c2;
+        int out_channels;
+        unsigned char *a = stbi_load_from_memory(jpeg.data, (int)jpeg.size, &w1, &h1, &c1, req_channels);
+        unsigned char *b = parallel_jpeg_load_from_memory(jpeg.data, jpeg.size, &w2, &h2, &c2, req_channels);
+        out_channels = req_channels ? req_channels : c1;
+        ok = a && b && w1 == w2 && h1 == h2 && c1 == c2 && memcmp(a, b, (size_t)w1 * h1 * out_channels) == 0;
+        stbi_image_free(a);
+        stbi_image_free(b);
+    }
+
+    printf("  decodificar %5dx%-5d %d canales, calidad %d, pedidos %d: %s\n", width, height, channels, quality,
+           req_channels, ok ? "OK" : "FALLA");
+    free(jpeg.data);
+    free(image);
+    return ok;
+}
+
+int main(int argc, char *argv[])
+{
+    int megapixels = argc > 1 ? atoi(argv[1]) : DEFAULT_MEGAPIXELS;
+    int threads = argc > 2 ? atoi(argv[2]) : 0;
+    if (megapixels <= 0 || threads < 0)
+    {
+        fprintf(stderr, "Uso: %s [megapixeles] [hilos]\n", argv[0]);
+        return 1;
+    }
+
+    if (!thread_pool_init(threads))
+    {
+        fprintf(stderr, "No se pudo iniciar el pool de cómputo\n");
+        return 1;
+    }
+    printf("Concurrencia: %d\n", thread_pool_concurrency());
+
+    // Tamaños que no son múltiplo del MCU para ejercitar el relleno de bordes
+    int failures = 0;
+    printf("Exactitud (pixeles idénticos a la ruta secuencial de stb):\n");
+    failures += !verify(1000, 1000, 3);
+    failures += !verify(1023, 777, 4);
+    failures += !verify(641, 1201, 1);
+    failures += !verify(4000, 257, 2);
+    failures += !verify_decode(3000, 2001, 3, QUALITY, 0);
+    failures += !verify_decode(3000, 2001, 3, QUALITY_444, 0);
+    failures += !verify_decode(1023, 1777, 4, QUALITY, 4);
+    failures += !verify_decode(2049, 1500, 1, QUALITY, 0);
+
+    int width = 4000;
+    int height = megapixels * 1000 * 1000 / width;
+    unsigned char *image = make_image(width, height, 3);
+    output_buffer_t sequential = {0}, parallel = {0};
+
+    double start = now_seconds();
+    stbi_write_jpg_to_func(append_bytes, &sequential, width, height, 3, image, QUALITY);
+    double sequential_time = now_seconds() - start;
+
+    start = now_seconds();
+    parallel_jpeg_write_to_func(append_bytes, &parallel, width, height, 3, image, QUALITY);
+    double parallel_time = now_seconds() - start;
+
+    printf("%dx%d codificar: secuencial %.3f s (%zu bytes), paralelo %.3f s (%zu bytes), %.2fx\n", width, height,
+           sequential_time, sequential.size, parallel_time, parallel.size, sequential_time / parallel_time);
+
+    int w, h, c;
+    start = now_seconds();
+    unsigned char *decoded = stbi_load_from_memory(parallel.data, (int)parallel.size, &w, &h, &c, 0);
+    sequential_time = now_seconds() - start;
+    stbi_image_free(decoded);
+
+    start = now_seconds();
+    decoded = parallel_jpeg_load_from_memory(parallel.data, parallel.size, &w, &h, &c, 0);
+    parallel_time = now_seconds() - start;
+    stbi_image_free(decoded);
+
+    printf("%dx%d decodificar: secuencial %.3f s, paralelo %.3f s, %.2fx\n", width, height, sequential_time,
+           parallel_time, sequential_time / parallel_time);
+
+    buffer_pool_stats_t pool_stats;
+    buffer_pool_get_stats(&pool_stats);
+    printf("Pool de buffers: %lu aciertos, %lu fallos, %zu bytes mapeados\n", pool_stats.hits, pool_stats.misses,
+           pool_stats.mapped_bytes);
+
+    free(sequential.data);
+    free(parallel.data);
+    free(image);
+    thread_pool_destroy();
+    return failures ? 1 : 0;
+}
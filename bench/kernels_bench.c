@@ -0,0 +1,185 @@
+// Verificación exhaustiva y benchmark de los kernels de histograma y LUT
+// Uso: kernels_bench [megapixeles]
+#include "image_kernels.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define DEFAULT_MEGAPIXELS 16
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Fórmula original de image_processor.c
+static unsigned char reference_luminance(int r, int g, int b)
+{
+    int luminance = (int)(0.299 * r + 0.587 * g + 0.114 * b);
+    if (luminance < 0)
+        luminance = 0;
+    if (luminance > 255)
+        luminance = 255;
+    return (unsigned char)luminance;
+}
+
+// Comparar la luminancia de las 2^24 combinaciones RGB (3 y 4 canales)
+static int verify_luminance(void)
+{
+    const size_t count = 1 << 24;
+    unsigned char *pixels = malloc(count * 4);
+    unsigned char *luminance = malloc(count);
+    if (!pixels || !luminance)
+    {
+        perror("malloc");
+        exit(1);
+    }
+
+    for (int channels = 3; channels <= 4; channels++)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            unsigned char *p = pixels + i * channels;
+            p[0] = (unsigned char)(i >> 16);
+            p[1] = (unsigned char)(i >> 8);
+            p[2] = (unsigned char)i;
+            if (channels == 4)
+                p[3] = (unsigned char)(i * 7);
+        }
+
+        kernel_luminance_row(pixels, count, channels, luminance);
+
+        for (size_t i = 0; i < count; i++)
+        {
+            unsigned char expected = reference_luminance((int)(i >> 16), (int)((i >> 8) & 0xFF), (int)(i & 0xFF));
+            if (luminance[i] != expected)
+            {
+                printf("  luminancia distinta (%d canales) en rgb=(%zu,%zu,%zu): %d != %d\n", channels,
+                       i >> 16, (i >> 8) & 0xFF, i & 0xFF, luminance[i], expected);
+                free(pixels);
+                free(luminance);
+                return 0;
+            }
+        }
+    }
+
+    free(pixels);
+    free(luminance);
+    return 1;
+}
+
+// Ecualización original de image_processor.c: R,G,B (o gris) mapeados, alpha intacto
+static void reference_lut(unsigned char *pixels, size_t count, int channels, const unsigned char lut[256])
+{
+    for (size_t i = 0; i < count; i++, pixels += channels)
+    {
+        pixels[0] = lut[pixels[0]];
+        if (channels >= 3)
+        {
+            pixels[1] = lut[pixels[1]];
+            pixels[2] = lut[pixels[2]];
+        }
+    }
+}
+
+// Comparar la LUT contra la referencia para 1-4 canales y longitudes variadas
+static int verify_lut(void)
+{
+    unsigned char lut[256];
+    unsigned char original[4 * 1031];
+    unsigned char expected[sizeof(original)];
+    unsigned char actual[sizeof(original)];
+
+    for (int i = 0; i < 256; i++)
+        lut[i] = (unsigned char)((i * 37 + 11) ^ 0x5A);
+    for (size_t i = 0; i < sizeof(original); i++)
+        original[i] = (unsigned char)(rand() & 0xFF);
+
+    for (int channels = 1; channels <= 4; channels++)
+    {
+        for (size_t count = 0; count <= 1031; count += 17)
+        {
+            memcpy(expected, original, count * channels);
+            memcpy(actual, original, count * channels);
+
+            reference_lut(expected, count, channels, lut);
+            kernel_apply_lut(actual, count, channels, lut);
+
+            if (memcmp(expected, actual, count * channels) != 0)
+            {
+                printf("  LUT distinta (%d canales, %zu pixeles)\n", channels, count);
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+int main(int argc, char *argv[])
+{
+    int megapixels = argc > 1 ? atoi(argv[1]) : DEFAULT_MEGAPIXELS;
+    if (megapixels <= 0)
+    {
+        fprintf(stderr, "Uso: %s [megapixeles]\n", argv[0]);
+        return 1;
+    }
+
+    size_t count = (size_t)megapixels * 1000 * 1000;
+    unsigned char *image = malloc(count * 4);
+    if (!image)
+    {
+        perror("malloc");
+        return 1;
+    }
+    unsigned int seed = 12345;
+    for (size_t i = 0; i < count * 4; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        image[i] = (unsigned char)(seed >> 16);
+    }
+
+    unsigned char lut[256];
+    for (int i = 0; i < 256; i++)
+        lut[i] = (unsigned char)(255 - i);
+
+    const kernel_impl_t impls[] = {KERNEL_IMPL_SCALAR, KERNEL_IMPL_SSE41, KERNEL_IMPL_AVX2};
+    const char *names[] = {"scalar", "sse4.1", "avx2"};
+    int failures = 0;
+
+    printf("Imagen: %d Mpx\n", megapixels);
+    for (size_t n = 0; n < sizeof(impls) / sizeof(impls[0]); n++)
+    {
+        if (!image_kernels_set_implementation(impls[n]))
+        {
+            printf("%-7s no soportado por esta CPU\n", names[n]);
+            continue;
+        }
+
+        int luminance_ok = verify_luminance();
+        int lut_ok = verify_lut();
+        failures += !luminance_ok + !lut_ok;
+
+        for (int channels = 3; channels <= 4; channels++)
+        {
+            int histogram[256] = {0};
+            double start = now_seconds();
+            kernel_luminance_histogram(image, count, channels, histogram);
+            double histogram_time = now_seconds() - start;
+
+            start = now_seconds();
+            kernel_apply_lut(image, count, channels, lut);
+            double lut_time = now_seconds() - start;
+
+            printf("%-7s %d canales: histograma %7.1f Mpx/s, LUT %7.1f Mpx/s\n", names[n], channels,
+                   megapixels / histogram_time, megapixels / lut_time);
+        }
+        printf("%-7s exactitud: luminancia %s, LUT %s\n", names[n],
+               luminance_ok ? "OK (2^24 combinaciones)" : "FALLA", lut_ok ? "OK" : "FALLA");
+    }
+
+    free(image);
+    return failures ? 1 : 0;
+}
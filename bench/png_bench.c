@@ -0,0 +1,139 @@
+// Verificación y benchmark del codificador PNG paralelo (deflate por grupos de filas)
+// Uso: png_bench [megapixeles] [hilos] [nivel]
+#include "png_encoder.h"
+#include "thread_pool.h"
+#include "stb/stb_image.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define DEFAULT_MEGAPIXELS 8
+#define DEFAULT_LEVEL 4
+
+typedef struct
+{
+    unsigned char *data;
+    size_t size;
+    size_t capacity;
+} output_buffer_t;
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void append_bytes(void *context, void *data, int size)
+{
+    output_buffer_t *out = (output_buffer_t *)context;
+    if (out->size + (size_t)size > out->capacity)
+    {
+        out->capacity = (out->size + (size_t)size) * 2;
+        out->data = realloc(out->data, out->capacity);
+        if (!out->data)
+        {
+            perror("realloc");
+            exit(1);
+        }
+    }
+    memcpy(out->data + out->size, data, (size_t)size);
+    out->size += (size_t)size;
+}
+
+// Degradado con ruido leve: comprime como una imagen real y no como un color plano
+static unsigned char *make_image(int width, int height, int channels)
+{
+    unsigned char *image = malloc((size_t)width * height * channels);
+    unsigned int seed = 12345;
+    if (!image)
+    {
+        perror("malloc");
+        exit(1);
+    }
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            unsigned char *p = image + ((size_t)y * width + x) * channels;
+            for (int c = 0; c < channels; c++)
+            {
+                seed = seed * 1103515245 + 12345;
+                p[c] = (unsigned char)(((x * (c + 1) + y * (3 - c)) / 8 + ((seed >> 16) & 3)) & 0xFF);
+            }
+        }
+    }
+    return image;
+}
+
+// PNG es sin pérdida: la decodificación debe reproducir los pixeles originales
+static int verify(int width, int height, int channels, int level)
+{
+    unsigned char *image = make_image(width, height, channels);
+    output_buffer_t out = {0};
+    int ok = 0;
+
+    if (parallel_png_write_to_func(append_bytes, &out, width, height, channels, image, level))
+    {
+        int w, h, c;
+        unsigned char *decoded = stbi_load_from_memory(out.data, (int)out.size, &w, &h, &c, 0);
+        ok = decoded && w == width && h == height && c == channels &&
+             memcmp(decoded, image, (size_t)width * height * channels) == 0;
+        stbi_image_free(decoded);
+    }
+
+    printf("  %5dx%-5d %d canales, nivel %d: %s\n", width, height, channels, level, ok ? "OK" : "FALLA");
+    free(out.data);
+    free(image);
+    return ok;
+}
+
+int main(int argc, char *argv[])
+{
+    int megapixels = argc > 1 ? atoi(argv[1]) : DEFAULT_MEGAPIXELS;
+    int threads = argc > 2 ? atoi(argv[2]) : 0;
+    int level = argc > 3 ? atoi(argv[3]) : DEFAULT_LEVEL;
+    if (megapixels <= 0 || threads < 0 || level < 0 || level > 9)
+    {
+        fprintf(stderr, "Uso: %s [megapixeles] [hilos] [nivel 0-9]\n", argv[0]);
+        return 1;
+    }
+
+    if (!thread_pool_init(threads))
+    {
+        fprintf(stderr, "No se pudo iniciar el pool de cómputo\n");
+        return 1;
+    }
+    printf("Concurrencia: %d\n", thread_pool_concurrency());
+
+    int failures = 0;
+    printf("Exactitud (decodificación idéntica a la entrada):\n");
+    failures += !verify(1000, 1000, 3, level);
+    failures += !verify(1023, 777, 4, level);
+    failures += !verify(641, 1201, 1, 9);
+    failures += !verify(4000, 257, 2, 0);
+    failures += !verify(7, 3, 3, 1);
+
+    int width = 4000;
+    int height = megapixels * 1000 * 1000 / width;
+    unsigned char *image = make_image(width, height, 3);
+    output_buffer_t sequential = {0}, parallel = {0};
+
+    double start = now_seconds();
+    stbi_write_png_to_func(append_bytes, &sequential, width, height, 3, image, width * 3);
+    double sequential_time = now_seconds() - start;
+
+    start = now_seconds();
+    parallel_png_write_to_func(append_bytes, &parallel, width, height, 3, image, level);
+    double parallel_time = now_seconds() - start;
+
+    printf("%dx%d: stb %.3f s (%zu bytes), paralelo nivel %d %.3f s (%zu bytes), %.2fx\n", width, height,
+           sequential_time, sequential.size, level, parallel_time, parallel.size, sequential_time / parallel_time);
+
+    free(sequential.data);
+    free(parallel.data);
+    free(image);
+    thread_pool_destroy();
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,95 @@
+// Microbenchmark del buscador de delimitadores multipart
+// Uso: scanner_bench [MB] [iteraciones]
+#include "scanner.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define DEFAULT_BODY_MB 50
+#define DEFAULT_ITERATIONS 10
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Buscar el delimitador con memmem de glibc como referencia
+static const char *find_memmem(const char *data, size_t len, const char *needle, size_t needle_len)
+{
+    return memmem(data, len, needle, needle_len);
+}
+
+// Medir el throughput de una función de búsqueda sobre el body completo
+static void run_case(const char *name, const char *(*find)(const char *, size_t, const char *, size_t),
+                     const char *body, size_t body_len, const char *delimiter, size_t delimiter_len,
+                     int iterations)
+{
+    const char *expected = body + body_len - delimiter_len - 4;
+    double start = now_seconds();
+
+    for (int i = 0; i < iterations; i++)
+    {
+        const char *match = find(body, body_len, delimiter, delimiter_len);
+        if (match != expected)
+        {
+            fprintf(stderr, "%s: resultado incorrecto\n", name);
+            exit(1);
+        }
+    }
+
+    double elapsed = now_seconds() - start;
+    double gbps = (double)body_len * iterations / elapsed / 1e9;
+    printf("%-8s %8.2f GB/s\n", name, gbps);
+}
+
+int main(int argc, char *argv[])
+{
+    size_t body_mb = argc > 1 ? (size_t)atoi(argv[1]) : DEFAULT_BODY_MB;
+    int iterations = argc > 2 ? atoi(argv[2]) : DEFAULT_ITERATIONS;
+    if (body_mb == 0 || iterations <= 0)
+    {
+        fprintf(stderr, "Uso: %s [MB] [iteraciones]\n", argv[0]);
+        return 1;
+    }
+
+    const char delimiter[] = "\r\n------WebKitFormBoundary7MA4YWxkTrZu0gW";
+    size_t delimiter_len = sizeof(delimiter) - 1;
+    size_t body_len = body_mb * 1024 * 1024;
+
+    // Body con bytes pseudoaleatorios (incluye '\r' y '-' sueltos) y el delimitador al final
+    char *body = malloc(body_len);
+    if (!body)
+    {
+        perror("malloc");
+        return 1;
+    }
+    unsigned int seed = 12345;
+    for (size_t i = 0; i < body_len; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        body[i] = (char)(seed >> 16);
+    }
+    memcpy(body + body_len - delimiter_len - 4, delimiter, delimiter_len);
+    memcpy(body + body_len - 4, "--\r\n", 4);
+
+    printf("Body: %zu MB, %d iteraciones\n", body_mb, iterations);
+
+    run_case("memmem", find_memmem, body, body_len, delimiter, delimiter_len, iterations);
+
+    const scanner_impl_t impls[] = {SCANNER_IMPL_SCALAR, SCANNER_IMPL_SSE2, SCANNER_IMPL_AVX2};
+    for (size_t i = 0; i < sizeof(impls) / sizeof(impls[0]); i++)
+    {
+        if (!scanner_set_implementation(impls[i]))
+        {
+            printf("%-8s no soportado por esta CPU\n", i == 1 ? "sse2" : "avx2");
+            continue;
+        }
+        run_case(scanner_implementation_name(), scan_find, body, body_len, delimiter, delimiter_len, iterations);
+    }
+
+    free(body);
+    return 0;
+}
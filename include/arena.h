@@ -0,0 +1,68 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+// Tamaño de los bloques de la arena; las reservas mayores a la mitad
+// reciben un bloque propio (el body de un upload)
+#define ARENA_CHUNK_SIZE (16 * 1024)
+#define ARENA_ALIGNMENT 16
+
+typedef struct arena_chunk arena_chunk_t;
+
+// Arena por petición: reservas por desplazamiento que se liberan todas juntas.
+// No es thread-safe; la usa un solo dueño a la vez (el reactor mientras lee
+// la petición, el procesador mientras la conexión espera en la cola)
+typedef struct
+{
+    arena_chunk_t *chunks; // El primero es el bloque activo
+    size_t used;           // Bytes entregados desde el último reset
+    size_t reserved;       // Bytes reservados en bloques
+    int chunk_count;
+    size_t peak_used;      // Máximos antes de un arena_reset
+    size_t peak_reserved;
+} arena_t;
+
+// Estadísticas acumuladas de las arenas liberadas
+typedef struct
+{
+    unsigned long requests;         // Arenas liberadas con al menos una reserva
+    unsigned long long total_peak;  // Suma de picos, para el promedio
+    size_t max_peak;                // Mayor pico de una petición
+    size_t max_reserved;            // Mayor memoria reservada por una petición
+} arena_stats_t;
+
+/**
+ * Inicializar una arena vacía (no reserva memoria hasta la primera reserva)
+ * @param arena Arena a inicializar
+ */
+void arena_init(arena_t *arena);
+
+/**
+ * Reservar memoria de la arena, alineada a ARENA_ALIGNMENT
+ * @param arena Arena
+ * @param size Bytes pedidos
+ * @return Puntero válido hasta arena_reset/arena_release, o NULL si error
+ */
+void *arena_alloc(arena_t *arena, size_t size);
+
+/**
+ * Liberar todos los bloques sin cerrar la petición: el pico se conserva y se
+ * registra en arena_release
+ * @param arena Arena (queda vacía y reutilizable)
+ */
+void arena_reset(arena_t *arena);
+
+/**
+ * Liberar de una vez todos los bloques y registrar el pico de la petición
+ * @param arena Arena (queda vacía y reutilizable)
+ */
+void arena_release(arena_t *arena);
+
+/**
+ * Obtener las estadísticas acumuladas de las arenas liberadas
+ * @param stats Estructura a llenar
+ */
+void arena_get_stats(arena_stats_t *stats);
+
+#endif // ARENA_H
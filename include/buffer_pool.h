@@ -0,0 +1,59 @@
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+#include <stddef.h>
+
+// Por debajo de este tamaño las reservas van directo a malloc
+#define BUFFER_POOL_MIN_SIZE (64 * 1024)
+// Clases de tamaño potencia de dos: 64 KB .. 512 MB
+#define BUFFER_POOL_CLASSES 14
+
+// Estadísticas del pool de buffers
+typedef struct
+{
+    unsigned long hits;          // Reservas servidas con un bloque ya mapeado
+    unsigned long misses;        // Reservas que mapearon un bloque nuevo
+    unsigned long releases;      // Bloques devueltos al sistema (pool lleno o fuera de clase)
+    unsigned long small_allocs;  // Reservas pequeñas delegadas a malloc
+    size_t cached_bytes;         // Bytes en bloques libres retenidos
+    size_t mapped_bytes;         // Bytes mapeados por el pool (en uso + libres)
+    int hugepages;               // MADV_HUGEPAGE activo
+} buffer_pool_stats_t;
+
+/**
+ * Configurar el pool (llamar antes de empezar a procesar)
+ * @param max_cached_bytes Máximo de bytes libres retenidos entre todos los hilos
+ * @param use_hugepages 1 para pedir MADV_HUGEPAGE en bloques de 2 MB o más
+ */
+void buffer_pool_configure(size_t max_cached_bytes, int use_hugepages);
+
+/**
+ * Reservar un buffer. Los de BUFFER_POOL_MIN_SIZE o más salen de la clase de
+ * tamaño correspondiente: primero de la caché del hilo, luego de la global
+ * @param size Bytes pedidos
+ * @return Puntero (alineado a 64 bytes si sale del pool) o NULL si error
+ */
+void *buffer_pool_alloc(size_t size);
+
+/**
+ * Redimensionar un buffer del pool conservando su contenido; si la capacidad
+ * de la clase alcanza se devuelve el mismo puntero
+ * @param ptr Buffer del pool o NULL
+ * @param size Nuevo tamaño
+ * @return Puntero al buffer (puede cambiar) o NULL si error
+ */
+void *buffer_pool_realloc(void *ptr, size_t size);
+
+/**
+ * Devolver un buffer al pool (NULL se ignora)
+ * @param ptr Buffer obtenido de buffer_pool_alloc/buffer_pool_realloc
+ */
+void buffer_pool_free(void *ptr);
+
+/**
+ * Obtener las estadísticas del pool
+ * @param stats Estructura a llenar
+ */
+void buffer_pool_get_stats(buffer_pool_stats_t *stats);
+
+#endif // BUFFER_POOL_H
@@ -15,6 +15,9 @@ typedef struct {
     char log_level[32];
     int max_connections;
     int thread_pool_size;
+    int reactor_threads;
+    int reuseport_listeners;
+    int compute_threads; // Hilos del pool de cómputo por bandas (0 = uno por CPU)
     
     // Rutas de directorios
     char image_base_path[MAX_PATH_LENGTH];
@@ -28,6 +31,10 @@ typedef struct {
     int max_image_size_mb;
     char supported_formats[256];
     int histogram_bins;
+    int png_compression_level; // Nivel de deflate para PNG (0 = sin compresión, 9 = máxima)
+    int buffer_pool_mb;        // Máximo de MB en buffers libres retenidos por el pool
+    int buffer_pool_hugepages; // Pedir MADV_HUGEPAGE para los buffers grandes
+    int memory_job_budget_mb;  // Uploads encolados en memoria hasta este total (0 = siempre a disco)
 } server_config_t;
 
 // Configuración global
@@ -19,10 +19,14 @@
 #define MAX_FILENAME_SIZE 256
 #define MAX_BOUNDARY_SIZE 128
 #define MAX_CONTENT_TYPE_SIZE 256
+#define MAX_PART_HEADERS_SIZE 1024
 
 // Formatos de imagen soportados
 #define SUPPORTED_FORMATS "jpg,jpeg,png,gif"
 
+// Límite de dimensiones aceptadas (también se aplica al decoder de stb_image)
+#define MAX_IMAGE_DIMENSION 10000
+
 // Códigos de error específicos para file handling
 typedef enum
 {
@@ -37,6 +41,15 @@ typedef enum
     FILE_UPLOAD_ERROR_NO_CONTENT_TYPE = -8
 } file_upload_error_t;
 
+// Formato de imagen detectado por su firma (magic bytes)
+typedef enum
+{
+    IMAGE_FORMAT_UNKNOWN = 0,
+    IMAGE_FORMAT_JPEG,
+    IMAGE_FORMAT_PNG,
+    IMAGE_FORMAT_GIF
+} image_format_t;
+
 // Estructura para información de archivo subido
 typedef struct
 {
@@ -45,22 +58,82 @@ typedef struct
     size_t file_size;                          // Tamaño del archivo en bytes
     char content_type[64];                     // Content-Type del archivo
     time_t upload_time;                        // Timestamp del upload
+    int image_width;                           // Dimensiones leídas del header de la imagen
+    int image_height;                          // (validación sin decodificar pixeles)
+    int image_channels;
+    image_format_t image_format;               // Formato según los magic bytes
 } file_upload_info_t;
 
+// Estados del parser multipart incremental
+typedef enum
+{
+    MULTIPART_PREAMBLE,     // Buscando el primer boundary
+    MULTIPART_DELIMITER,    // Boundary encontrado, esperando "--" o CRLF
+    MULTIPART_PART_HEADERS, // Leyendo headers de una parte
+    MULTIPART_PART_DATA,    // Datos de la parte, buscando el siguiente boundary
+    MULTIPART_DONE,
+    MULTIPART_ERROR
+} multipart_state_t;
+
+// Parser multipart/form-data que avanza a medida que llegan los bytes del body.
+// Trabaja sobre el buffer contiguo del body: los datos del archivo no se copian,
+// upload_info->file_data apunta directamente dentro del body.
+typedef struct
+{
+    multipart_state_t state;
+    char delimiter[MAX_BOUNDARY_SIZE + 5]; // CRLF--boundary
+    size_t delimiter_len;
+    size_t scanned;    // Offset hasta donde se analizó el body
+    size_t part_start; // Offset de inicio de los headers o datos de la parte actual
+    int in_file_part;
+    int file_found;
+    file_upload_info_t *upload_info;
+} multipart_parser_t;
+
 // =============================================================================
 // FUNCIONES PRINCIPALES DE MANEJO DE ARCHIVOS
 // =============================================================================
 
 /**
- * Procesar una petición HTTP POST completa con archivo
+ * Validar los headers de un upload e inicializar el parser multipart del body
+ * @param client_socket Socket del cliente (para responder errores)
+ * @param headers Headers HTTP de la petición (terminados en NUL)
+ * @param parser Parser a inicializar
+ * @param upload_info Estructura donde el parser dejará la información del archivo
+ * @return 0 en éxito, -1 en error (la respuesta de error ya fue enviada)
+ */
+int begin_file_upload(int client_socket, const char *headers,
+                      multipart_parser_t *parser, file_upload_info_t *upload_info);
+
+/**
+ * Procesar un archivo ya extraído del body: validar, guardar y encolar
  * @param client_socket Socket del cliente
- * @param request_data Datos completos de la petición HTTP
- * @param request_len Longitud de los datos de petición
+ * @param upload_info Información del archivo extraída por el parser multipart
  * @param client_ip IP del cliente (para logging)
  * @return 0 en éxito, código de error negativo en fallo
  */
-int handle_file_upload_request(int client_socket, const char *request_data,
-                               size_t request_len, const char *client_ip);
+int handle_file_upload_request(int client_socket, const file_upload_info_t *upload_info,
+                               const char *client_ip);
+
+/**
+ * Validar y encolar un upload raw (PUT o POST application/octet-stream) cuyo
+ * body ya se transfirió con splice a un spool anónimo
+ * @param client_socket Socket del cliente
+ * @param spool_fd Spool con el body completo; la función siempre toma su propiedad
+ * @param size Bytes del body
+ * @param filename Nombre tomado de la ruta de la petición (NULL o vacío = "upload")
+ * @param client_ip IP del cliente (para logging)
+ * @return 0 en éxito, -1 en error (la respuesta de error ya fue enviada)
+ */
+int handle_raw_upload_request(int client_socket, int spool_fd, size_t size, const char *filename,
+                              const char *client_ip);
+
+/**
+ * Abrir un archivo de spool sin nombre (memfd en tmpfs, O_TMPFILE en otro caso)
+ * en el directorio temporal; desaparece al cerrar el descriptor
+ * @return Descriptor o -1 si el sistema de archivos no lo soporta
+ */
+int open_upload_spool(void);
 
 /**
  * Parsear datos multipart/form-data y extraer información del archivo
@@ -73,6 +146,32 @@ int handle_file_upload_request(int client_socket, const char *request_data,
 int parse_multipart_data(const char *data, size_t data_len, const char *boundary,
                          file_upload_info_t *upload_info);
 
+/**
+ * Inicializar parser multipart incremental
+ * @param parser Parser a inicializar
+ * @param boundary Boundary del multipart (sin el prefijo "--")
+ * @param upload_info Estructura donde guardar la información extraída
+ * @return 0 en éxito, código de error negativo en fallo
+ */
+int multipart_parser_init(multipart_parser_t *parser, const char *boundary,
+                          file_upload_info_t *upload_info);
+
+/**
+ * Avanzar el parser sobre los bytes recibidos hasta el momento
+ * @param parser Parser inicializado
+ * @param data Inicio del body (el mismo buffer en cada llamada)
+ * @param available Bytes del body disponibles hasta ahora
+ * @return 1 si se encontró el boundary de cierre, 0 si faltan datos, -1 en error
+ */
+int multipart_parser_feed(multipart_parser_t *parser, const char *data, size_t available);
+
+/**
+ * Verificar el resultado del parser al terminar el body
+ * @param parser Parser alimentado con el body completo
+ * @return 0 si se extrajo un archivo válido, código de error negativo en fallo
+ */
+int multipart_parser_finish(multipart_parser_t *parser);
+
 /**
  * Guardar archivo subido en disco con validación
  * @param upload_info Información del archivo a guardar
@@ -94,6 +193,21 @@ int save_uploaded_file(const file_upload_info_t *upload_info,
  */
 int is_supported_format(const char *filename);
 
+/**
+ * Detectar el formato de una imagen por su firma (JPEG SOI, PNG, GIF87a/89a)
+ * @param data Primeros bytes del archivo
+ * @param size Bytes disponibles
+ * @return Formato detectado, IMAGE_FORMAT_UNKNOWN si no coincide ninguna firma
+ */
+image_format_t detect_image_format(const unsigned char *data, size_t size);
+
+/**
+ * Obtener el nombre de un formato de imagen
+ * @param format Formato
+ * @return Nombre en minúsculas ("jpeg", "png", "gif" o "unknown")
+ */
+const char *image_format_name(image_format_t format);
+
 /**
  * Generar nombre único para archivo temporal
  * @param temp_filename Buffer para el nombre generado
@@ -194,6 +308,15 @@ long long get_available_disk_space(const char *path);
 #define LOG_FILE_INFO(fmt, ...) LOG_INFO("[FILE_HANDLER] " fmt, ##__VA_ARGS__)
 #define LOG_FILE_DEBUG(fmt, ...) LOG_DEBUG("[FILE_HANDLER] " fmt, ##__VA_ARGS__)
 
-int validate_image_data(const unsigned char *data, size_t size);
+/**
+ * Validar una imagen leyendo solo su header (no decodifica los pixeles)
+ * @param data Datos de la imagen
+ * @param size Tamaño de los datos
+ * @param width Salida: ancho (puede ser NULL)
+ * @param height Salida: alto (puede ser NULL)
+ * @param channels Salida: número de canales (puede ser NULL)
+ * @return 1 si es válida, 0 si no
+ */
+int validate_image_data(const unsigned char *data, size_t size, int *width, int *height, int *channels);
 
 #endif // FILE_HANDLER_H
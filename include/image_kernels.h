@@ -0,0 +1,71 @@
+#ifndef IMAGE_KERNELS_H
+#define IMAGE_KERNELS_H
+
+#include <stddef.h>
+
+// Implementaciones disponibles de los kernels de pixeles
+typedef enum
+{
+    KERNEL_IMPL_AUTO = 0, // Elegida por CPUID al primer uso
+    KERNEL_IMPL_SCALAR,
+    KERNEL_IMPL_SSE41,
+    KERNEL_IMPL_AVX2
+} kernel_impl_t;
+
+/**
+ * Calcular la luminancia de pixeles contiguos, idéntica bit a bit a
+ * (int)(0.299 * r + 0.587 * g + 0.114 * b) para 3-4 canales; el primer
+ * canal para 1-2 canales
+ * @param pixels Pixeles de entrada
+ * @param count Número de pixeles
+ * @param channels Canales por pixel (1-4)
+ * @param luminance Salida: un byte por pixel
+ */
+void kernel_luminance_row(const unsigned char *pixels, size_t count, int channels,
+                          unsigned char *luminance);
+
+/**
+ * Acumular el histograma de luminancia de pixeles contiguos
+ * @param pixels Pixeles de entrada
+ * @param count Número de pixeles
+ * @param channels Canales por pixel (1-4)
+ * @param histogram Histograma donde se suman las cuentas (no se inicializa)
+ */
+void kernel_luminance_histogram(const unsigned char *pixels, size_t count, int channels,
+                                int histogram[256]);
+
+/**
+ * Histograma de luminancia y sumas de canales en una sola lectura de los pixeles
+ * @param pixels Pixeles de entrada
+ * @param count Número de pixeles
+ * @param channels Canales por pixel (1-4)
+ * @param histogram Histograma donde se suman las cuentas (no se inicializa)
+ * @param channel_sums Sumas de R, G, B donde se acumula (no se inicializa;
+ *                     NULL o menos de 3 canales: no se calculan)
+ */
+void kernel_analyze_pixels(const unsigned char *pixels, size_t count, int channels,
+                           int histogram[256], long long channel_sums[3]);
+
+/**
+ * Aplicar una tabla de mapeo a los canales de color (R,G,B o gris); el alpha no se modifica
+ * @param pixels Pixeles a modificar in-place
+ * @param count Número de pixeles
+ * @param channels Canales por pixel (1-4)
+ * @param lut Tabla de 256 entradas
+ */
+void kernel_apply_lut(unsigned char *pixels, size_t count, int channels, const unsigned char lut[256]);
+
+/**
+ * Forzar una implementación concreta (verificación y benchmarks)
+ * @param impl Implementación deseada; AUTO vuelve a la detección por CPUID
+ * @return 1 si la CPU la soporta y quedó activa, 0 si no
+ */
+int image_kernels_set_implementation(kernel_impl_t impl);
+
+/**
+ * Nombre de la implementación activa
+ * @return "scalar", "sse4.1" o "avx2"
+ */
+const char *image_kernels_implementation_name(void);
+
+#endif // IMAGE_KERNELS_H
@@ -63,7 +63,40 @@ void calculate_cumulative_histogram(const int histogram[256], int cumulative[256
  */
 int equalize_histogram(unsigned char *image_data, int width, int height, int channels);
 
+/**
+ * Aplica ecualización usando un histograma ya calculado (solo la pasada de remapeo)
+ * @param image_data: datos de la imagen (se modifica in-place)
+ * @param width: ancho de la imagen
+ * @param height: alto de la imagen
+ * @param channels: número de canales
+ * @param histogram: histograma de luminancia de la imagen
+ * @return: 1 si exitoso, 0 si error
+ */
+int equalize_with_histogram(unsigned char *image_data, int width, int height, int channels,
+                            const int histogram[256]);
+
+/**
+ * Analiza la imagen en una sola lectura: histograma de luminancia y sumas de canales
+ * @param image_data: datos de la imagen
+ * @param width: ancho de la imagen
+ * @param height: alto de la imagen
+ * @param channels: número de canales
+ * @param histogram: array de 256 elementos para almacenar el histograma
+ * @param channel_sums: sumas de R, G, B (NULL si no se necesitan; ceros con menos de 3 canales)
+ */
+void analyze_image(const unsigned char *image_data, int width, int height, int channels,
+                   int histogram[256], long long channel_sums[3]);
+
 // Funciones de clasificación por color
+/**
+ * Determina el color predominante a partir de las sumas de canales
+ * @param channel_sums: sumas de R, G, B
+ * @param total_pixels: número de pixeles de la imagen
+ * @param channels: número de canales
+ * @return: categoría de color predominante
+ */
+color_category_t classify_channel_sums(const long long channel_sums[3], long long total_pixels, int channels);
+
 /**
  * Determina el color predominante en una imagen
  * @param image_data: datos de la imagen
@@ -102,6 +135,26 @@ void generate_processed_filename(const char *original_filename, const char *suff
  */
 int process_image_complete(const char *input_filepath, const char *original_filename, processed_image_info_t *result);
 
+/**
+ * Procesa una imagen ya en memoria (upload encolado sin archivo temporal)
+ * @param data: contenido del archivo
+ * @param size: tamaño en bytes
+ * @param original_filename: nombre del archivo original (para generar nombres de salida)
+ * @param result: estructura para almacenar información del resultado
+ * @return: 0 si exitoso, -1 si error
+ */
+int process_image_from_memory(const unsigned char *data, size_t size, const char *original_filename,
+                              processed_image_info_t *result);
+
+/**
+ * Procesa una imagen volcada a un archivo anónimo (se lee desde el inicio)
+ * @param fd: descriptor del spool (el llamador lo cierra)
+ * @param original_filename: nombre del archivo original (para generar nombres de salida)
+ * @param result: estructura para almacenar información del resultado
+ * @return: 0 si exitoso, -1 si error
+ */
+int process_image_from_fd(int fd, const char *original_filename, processed_image_info_t *result);
+
 /**
  * Limpia archivo temporal después del procesamiento
  * @param temp_filepath: ruta del archivo temporal
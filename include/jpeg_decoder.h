@@ -0,0 +1,23 @@
+#ifndef JPEG_DECODER_H
+#define JPEG_DECODER_H
+
+#include <stddef.h>
+
+/**
+ * Decodificar una imagen desde memoria. Los JPEG baseline con intervalos de
+ * reinicio (DRI) se dividen en franjas de filas de MCU alineadas a marcadores
+ * RSTn que se decodifican en paralelo en el pool de cómputo; el resultado es
+ * idéntico al de stbi_load_from_memory. Cualquier otra imagen (o JPEG sin
+ * reinicios alineables) usa el decodificador secuencial de stb
+ * @param data Contenido del archivo
+ * @param size Tamaño en bytes
+ * @param width Salida: ancho
+ * @param height Salida: alto
+ * @param channels Salida: canales del archivo
+ * @param req_channels Canales pedidos (0 = los del archivo)
+ * @return Pixeles (liberar con stbi_image_free) o NULL si error
+ */
+unsigned char *parallel_jpeg_load_from_memory(const unsigned char *data, size_t size, int *width, int *height,
+                                              int *channels, int req_channels);
+
+#endif // JPEG_DECODER_H
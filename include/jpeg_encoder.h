@@ -0,0 +1,24 @@
+#ifndef JPEG_ENCODER_H
+#define JPEG_ENCODER_H
+
+#include "stb/stb_image_write.h"
+
+/**
+ * Codificar un JPEG baseline en paralelo: la imagen se divide en franjas de
+ * filas de MCU que se codifican en el pool de cómputo con el codificador de
+ * stb y se unen separadas por marcadores de reinicio (RSTn). Los coeficientes
+ * son los mismos que produce stbi_write_jpg_to_func; imágenes pequeñas o sin
+ * pool se codifican secuencialmente con stb
+ * @param func Callback de salida (misma firma que stbi_write_*_to_func)
+ * @param context Contexto del callback
+ * @param width Ancho de la imagen
+ * @param height Alto de la imagen
+ * @param channels Canales por pixel (1-4)
+ * @param data Pixeles de entrada
+ * @param quality Calidad JPEG (1-100)
+ * @return 1 si exitoso, 0 si error
+ */
+int parallel_jpeg_write_to_func(stbi_write_func *func, void *context, int width, int height, int channels,
+                                const unsigned char *data, int quality);
+
+#endif // JPEG_ENCODER_H
@@ -0,0 +1,23 @@
+#ifndef PNG_ENCODER_H
+#define PNG_ENCODER_H
+
+#include "stb/stb_image_write.h"
+
+/**
+ * Codificar un PNG en paralelo al estilo pigz: la imagen se divide en grupos
+ * de filas que se filtran y comprimen con deflate en el pool de cómputo. Cada
+ * grupo termina con un sync flush (queda alineado a byte) y se emite como un
+ * chunk IDAT propio; juntos forman un único flujo zlib
+ * @param func Callback de salida (misma firma que stbi_write_*_to_func)
+ * @param context Contexto del callback
+ * @param width Ancho de la imagen
+ * @param height Alto de la imagen
+ * @param channels Canales por pixel (1-4)
+ * @param data Pixeles de entrada
+ * @param level Nivel de compresión deflate (0-9)
+ * @return 1 si exitoso, 0 si error
+ */
+int parallel_png_write_to_func(stbi_write_func *func, void *context, int width, int height, int channels,
+                               const unsigned char *data, int level);
+
+#endif // PNG_ENCODER_H
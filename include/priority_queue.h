@@ -6,10 +6,22 @@
 #include <string.h>
 #include <pthread.h>
 #include <time.h>
+#include <stdint.h>
 #include "file_handler.h"
 #include "server.h"
 
 #define MAX_QUEUE_SIZE 100
+#define MAX_PROCESSOR_WORKERS 50 // Mismo límite que valida config para THREAD_POOL_SIZE
+
+// Modelo de costo para shortest-job-first: muestras (ancho × alto × canales)
+// por un peso según el formato de entrada. Ecualizar y reescribir cuesta lo
+// mismo por muestra; el peso refleja sobre todo la decodificación
+#define COST_WEIGHT_JPEG 4 // Huffman + IDCT + upsampling de croma
+#define COST_WEIGHT_PNG 3  // inflate + desfiltrado
+#define COST_WEIGHT_GIF 2  // LZW sobre paleta
+// Sin dimensiones (no debería pasar tras validar): muestras estimadas por byte comprimido
+#define COST_SAMPLES_PER_BYTE 10
+#define QUEUE_REPORT_MAX_JOBS 16 // Jobs pendientes listados en /queue
 
 // Estructura para elementos en la cola de prioridad
 typedef struct
@@ -17,23 +29,72 @@ typedef struct
     file_upload_info_t upload_info;
     size_t file_size;
     time_t received_time;
-    char temp_filepath[512];
+    char temp_filepath[512]; // Vacío en jobs en memoria o con spool anónimo
+    int spool_fd;            // Spool anónimo (O_TMPFILE/memfd), -1 si no hay; lo cierra el worker
+    int in_memory;           // Los bytes están en upload_info.file_data (body de la conexión)
     char client_ip[64];
     int client_socket;
-    int priority; // Menor tamaño = mayor prioridad (menor número)
+    uint64_t cost; // Costo estimado (estimate_processing_cost): menor costo = mayor prioridad
 } priority_queue_item_t;
 
-// Cola de prioridad (min-heap basada en tamaño de archivo)
+// Resumen de un job pendiente para /queue
+typedef struct
+{
+    char filename[MAX_FILENAME_SIZE];
+    int width;
+    int height;
+    int channels;
+    image_format_t format;
+    size_t file_size;
+    uint64_t cost;
+} queued_job_info_t;
+
+// Min-heap local de un worker (basado en el costo estimado). Guarda índices
+// en processing_queue.slots: los elementos completos existen una sola vez
 typedef struct
 {
-    priority_queue_item_t items[MAX_QUEUE_SIZE];
+    int items[MAX_QUEUE_SIZE];
     int size;
-    pthread_mutex_t queue_mutex;
+    pthread_mutex_t mutex;
+} worker_heap_t;
+
+// Cola de prioridad con un heap por worker y robo de trabajo entre ellos.
+// size, next_heap e idle_workers se acceden con operaciones atómicas.
+typedef struct
+{
+    priority_queue_item_t slots[MAX_QUEUE_SIZE]; // Elementos encolados, compartidos por todos los heaps
+    int free_slots[MAX_QUEUE_SIZE];              // Pila de índices libres en slots
+    int free_count;
+    pthread_mutex_t slots_mutex; // Protege free_slots y free_count
+    worker_heap_t heaps[MAX_PROCESSOR_WORKERS];
+    int heap_count;
+    int size;                    // Total de elementos en todos los heaps
+    unsigned int next_heap;      // Round robin de encolado
+    int idle_workers;            // Workers dormidos esperando trabajo
+    pthread_mutex_t queue_mutex; // Solo para dormir/despertar workers ociosos
     pthread_cond_t queue_not_empty;
-    pthread_cond_t queue_not_full;
     int active; // Para controlar el shutdown del procesador
 } priority_queue_t;
 
+// Estadísticas de un worker del procesador
+typedef struct
+{
+    unsigned long files_processed;
+    unsigned long files_failed;
+    unsigned long long bytes_processed;
+    double busy_seconds; // Tiempo total procesando imágenes
+    int busy;            // 1 si está procesando un archivo en este momento
+} processor_worker_stats_t;
+
+// Worker del pool de procesamiento
+typedef struct
+{
+    int id;
+    pthread_t thread;
+    processor_worker_stats_t stats;
+    pthread_mutex_t stats_mutex;
+} processor_worker_t;
+
 // Variable global de la cola de prioridad
 extern priority_queue_t processing_queue;
 
@@ -42,12 +103,65 @@ int init_priority_queue(void);
 void destroy_priority_queue(void);
 
 // Operaciones de la cola
+/**
+ * Encolar un upload para procesamiento
+ * @param upload_info Información del archivo
+ * @param temp_filepath Archivo temporal con nombre, o NULL
+ * @param spool_fd Spool anónimo (la cola pasa a ser su dueña en éxito), o -1. Sin archivo
+ *                 ni spool el job va en memoria: usa upload_info->file_data, que debe
+ *                 seguir válido hasta que el worker libere la conexión
+ * @param client_ip IP del cliente
+ * @param client_socket Socket del cliente
+ * @return 0 en éxito, -1 en error
+ */
 int enqueue_file_for_processing(const file_upload_info_t *upload_info,
                                 const char *temp_filepath,
+                                int spool_fd,
                                 const char *client_ip,
                                 int client_socket);
 
-int dequeue_file_for_processing(priority_queue_item_t *item);
+/**
+ * Estimar el costo de procesar un upload a partir de su header (stbi_info)
+ * @param upload_info Upload validado (dimensiones, canales y formato)
+ * @return Costo en unidades relativas (muestras × peso del formato)
+ */
+uint64_t estimate_processing_cost(const file_upload_info_t *upload_info);
+
+/**
+ * Copiar los jobs pendientes (en orden de heap, no global)
+ * @param jobs Array destino
+ * @param max_jobs Capacidad del array
+ * @param total_cost Salida: suma del costo de todos los pendientes (puede ser NULL)
+ * @return Número de jobs copiados
+ */
+int get_queued_jobs(queued_job_info_t *jobs, int max_jobs, uint64_t *total_cost);
+
+/**
+ * Reservar presupuesto (MEMORY_JOB_BUDGET_MB) para un job en memoria
+ * @param bytes Tamaño del archivo
+ * @return 1 si cabe en el presupuesto, 0 si el upload debe ir a disco
+ */
+int reserve_memory_job(size_t bytes);
+
+/**
+ * Devolver el presupuesto de un job en memoria terminado o no encolado
+ * @param bytes Tamaño reservado
+ */
+void release_memory_job(size_t bytes);
+
+/**
+ * Bytes de uploads que están en memoria (encolados o en proceso)
+ * @return Total en bytes
+ */
+size_t get_memory_job_bytes(void);
+
+/**
+ * Extraer el próximo archivo para un worker: primero de su heap, luego robando de otros
+ * @param worker_id Id del worker que consume
+ * @param item Elemento extraído
+ * @return 0 si se extrajo un elemento, -1 en timeout o shutdown
+ */
+int dequeue_file_for_processing(int worker_id, priority_queue_item_t *item);
 
 // Funciones auxiliares
 int is_queue_empty(void);
@@ -58,15 +172,23 @@ void print_queue_status(void);
 // Función para debugging
 void debug_print_queue(void);
 
-// Hilo procesador de archivos
+// Pool de hilos procesadores de archivos (THREAD_POOL_SIZE workers)
 void *file_processor_thread(void *arg);
 int start_file_processor(void);
 void stop_file_processor(void);
 
 void get_queue_statistics(int *total_files, int *total_bytes, int *avg_file_size);
 
+/**
+ * Copiar las estadísticas de los workers del procesador
+ * @param stats Array de al menos MAX_PROCESSOR_WORKERS elementos
+ * @return Número de workers copiados
+ */
+int get_worker_statistics(processor_worker_stats_t *stats);
+
 // Variables globales del procesador
-extern pthread_t processor_thread;
+extern processor_worker_t processor_workers[MAX_PROCESSOR_WORKERS];
+extern int processor_worker_count;
 extern int processor_running;
 
 #endif // PRIORITY_QUEUE_H
\ No newline at end of file
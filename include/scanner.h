@@ -0,0 +1,47 @@
+#ifndef SCANNER_H
+#define SCANNER_H
+
+#include <stddef.h>
+
+// Implementaciones disponibles del buscador de bytes
+typedef enum
+{
+    SCANNER_IMPL_AUTO = 0, // Elegida por CPUID al primer uso
+    SCANNER_IMPL_SCALAR,
+    SCANNER_IMPL_SSE2,
+    SCANNER_IMPL_AVX2
+} scanner_impl_t;
+
+/**
+ * Buscar una secuencia de bytes en datos binarios (seguro con bytes NUL)
+ * @param haystack Datos donde buscar
+ * @param haystack_len Longitud de los datos
+ * @param needle Secuencia a buscar
+ * @param needle_len Longitud de la secuencia
+ * @return Puntero a la primera coincidencia, NULL si no existe
+ */
+const char *scan_find(const char *haystack, size_t haystack_len,
+                      const char *needle, size_t needle_len);
+
+/**
+ * Buscar el fin de headers HTTP (CRLFCRLF)
+ * @param data Datos donde buscar
+ * @param data_len Longitud de los datos
+ * @return Puntero al primer '\r' del separador, NULL si no existe
+ */
+const char *scan_find_header_end(const char *data, size_t data_len);
+
+/**
+ * Forzar una implementación concreta (benchmarks); AUTO vuelve a la detección por CPUID
+ * @param impl Implementación deseada
+ * @return 1 si la CPU la soporta y quedó activa, 0 si no
+ */
+int scanner_set_implementation(scanner_impl_t impl);
+
+/**
+ * Nombre de la implementación activa
+ * @return "scalar", "sse2" o "avx2"
+ */
+const char *scanner_implementation_name(void);
+
+#endif // SCANNER_H
@@ -12,11 +12,15 @@
 #include <errno.h>
 #include <time.h>
 #include <signal.h>
+#include <stdint.h>
+#include "file_handler.h"
+#include "arena.h"
 
 // Definiciones de constantes
 #define MAX_CLIENTS 50
 #define MAX_BUFFER_SIZE 8192
 #define MAX_UPLOAD_SIZE (50 * 1024 * 1024)
+#define RAW_UPLOAD_PIPE_SIZE (1024 * 1024) // Pipe de splice para uploads raw
 #define MAX_IMAGE_SIZE_MB 50
 #define DEFAULT_PORT 1717
 #define DEFAULT_MAX_CONNECTIONS 10
@@ -34,27 +38,98 @@ typedef enum
     SERVER_STOPPING
 } server_status_t;
 
-// Estructura para información de cliente
-typedef struct
+// Estados de una conexión dentro del reactor
+typedef enum
+{
+    CONN_READING_HEADERS,  // Recibiendo la línea de petición y headers
+    CONN_READING_BODY,     // Recibiendo el body según Content-Length
+    CONN_WAITING_QUEUE,    // Encolada, esperando al procesador de archivos
+    CONN_WRITING_RESPONSE  // Enviando la respuesta pendiente
+} connection_state_t;
+
+// Estructura para información de cliente (máquina de estados por conexión)
+typedef struct connection
 {
     int socket_fd;
     struct sockaddr_in address;
     char ip_str[INET_ADDRSTRLEN];
-    pthread_t thread_id;
-    int active;
+    connection_state_t state;
+    int reactor_id;
+    int peer_closed;
     time_t connection_time;
+    time_t last_activity;
+
+    // Body y respuesta salen de la arena; se liberan juntos al cerrar la conexión
+    arena_t arena;
+
+    // Petición recibida: headers en buffer fijo, body al tamaño de Content-Length
+    char headers[MAX_BUFFER_SIZE + 1];
+    size_t header_received;
+    size_t headers_len;
+    char *body;
+    size_t body_received;
+    size_t content_length;
+    char method[16];
+    char path[512];
+
+    // Upload multipart analizado a medida que llega el body
+    int is_upload;
+    multipart_parser_t multipart;
+    file_upload_info_t upload_info;
+
+    // Upload raw (PUT o POST application/octet-stream): el body pasa del socket
+    // al spool con splice a través de un pipe, sin copiarse a user space
+    int is_raw_upload;
+    int spool_fd;     // -1 si no hay; pasa a la cola al encolar
+    int pipe_fds[2];  // -1 si no hay
+    size_t pipe_bytes; // Bytes en el pipe pendientes de pasar al spool
+
+    // Respuesta pendiente de envío
+    char *response;
+    size_t response_len;
+    size_t response_sent;
+
+    // Enlaces en la lista del reactor y en la lista de completados
+    struct connection *prev;
+    struct connection *next;
+    struct connection *next_completed;
 } client_info_t;
 
+// Reactor de red: un hilo con su propio epoll
+typedef struct
+{
+    int id;
+    int listen_fd; // Socket de escucha propio (-1 si acepta otro reactor)
+    int epoll_fd;
+    int event_fd; // Notificaciones desde el procesador de archivos
+    pthread_t thread;
+    client_info_t *connections;
+    int connection_count;
+
+    pthread_mutex_t completed_mutex;
+    client_info_t *completed;
+} reactor_t;
+
+#define MAX_REACTORS 64
+#define MAX_EPOLL_EVENTS 128
+#define CONNECTION_IDLE_TIMEOUT 30
+
 // Estructura principal del servidor TCP
 typedef struct
 {
     int server_socket;
     struct sockaddr_in server_addr;
     server_status_t status;
-    pthread_t server_thread;
 
-    // Manejo de clientes
-    client_info_t clients[MAX_CLIENTS];
+    // Reactores de red
+    reactor_t reactors[MAX_REACTORS];
+    int reactor_count;
+    int sharded_listeners; // Un socket SO_REUSEPORT por reactor
+    int next_reactor;
+
+    // Tabla de conexiones indexada por descriptor
+    client_info_t **clients;
+    int max_fds;
     int client_count;
     pthread_mutex_t clients_mutex;
 } tcp_server_t;
@@ -89,17 +164,32 @@ void cleanup_server(void);
 // FUNCIONES DE HILOS Y CONEXIONES
 // ================================
 
-void *server_thread_func(void *arg);
-int accept_client_connection(void);
-int add_client(int socket_fd, struct sockaddr_in *client_addr);
-void *client_handler_thread(void *arg);
-void cleanup_inactive_clients(void);
+void *reactor_thread_func(void *arg);
+int accept_client_connection(reactor_t *reactor);
+int add_client(int socket_fd, struct sockaddr_in *client_addr, reactor_t *reactor);
+void handle_client_event(client_info_t *client, uint32_t events);
+void handle_client_request(client_info_t *client);
+void close_client_connection(client_info_t *client);
+void process_completed_connections(reactor_t *reactor);
+void cleanup_inactive_clients(reactor_t *reactor);
+
+/**
+ * Devolver una conexión encolada a su reactor para enviar la respuesta y cerrarla
+ * @param client_socket Socket del cliente
+ */
+void release_client_connection(int client_socket);
+
+/**
+ * Liberar el body de una conexión cuyo upload ya se volcó a disco (la arena
+ * conserva el pico para las estadísticas)
+ * @param client_socket Socket del cliente
+ */
+void release_client_body(int client_socket);
 
 // ================================
 // FUNCIONES DE PROTOCOLO HTTP
 // ================================
 
-int receive_complete_request(int client_socket, char *buffer, size_t buffer_size, size_t *total_received);
 int parse_http_request(const char *request, char *method, char *path);
 int send_http_response(int client_socket, int status_code, const char *content_type,
                        const char *content, size_t content_length);
@@ -109,7 +199,6 @@ int send_http_response(int client_socket, int status_code, const char *content_t
 // ================================
 
 int handle_get_request(int client_socket, const char *path, const char *client_ip);
-int handle_post_request(int client_socket, const char *request_data, size_t request_len, const char *client_ip);
 
 // ================================
 // FUNCIONES DE UTILIDAD
@@ -133,7 +222,6 @@ static inline int is_server_running(void)
 // ================================
 // FUNCIONES DE LOGGING Y ESTADÍSTICAS
 // ================================
-void mark_client_inactive(int client_socket);
 void show_detailed_server_stats(void);
 
 // ================================
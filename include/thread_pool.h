@@ -0,0 +1,40 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <pthread.h>
+
+#define MAX_COMPUTE_THREADS 256
+
+// Tarea de un parallel_for: se invoca una vez por cada índice en [0, count)
+typedef void (*parallel_task_fn)(void *ctx, int index);
+
+/**
+ * Iniciar el pool de hilos de cómputo compartido por los workers del procesador
+ * @param thread_count Número de hilos (0 = uno por CPU en línea)
+ * @return 1 si exitoso, 0 si error
+ */
+int thread_pool_init(int thread_count);
+
+/**
+ * Detener y unir los hilos del pool
+ */
+void thread_pool_destroy(void);
+
+/**
+ * Número de hilos que pueden ejecutar tareas en paralelo (pool + llamador),
+ * limitado a los CPUs disponibles para el proceso
+ * @return Grado de paralelismo disponible (1 si el pool no está iniciado o hay un solo CPU)
+ */
+int thread_pool_concurrency(void);
+
+/**
+ * Ejecutar fn(ctx, i) para cada i en [0, count) repartiendo los índices entre
+ * el pool y el hilo llamador, que también ejecuta tareas. Retorna cuando todas
+ * terminaron. Sin pool iniciado se ejecuta secuencialmente.
+ * @param count Número de tareas
+ * @param fn Función de la tarea
+ * @param ctx Contexto compartido por todas las tareas
+ */
+void parallel_for(int count, parallel_task_fn fn, void *ctx);
+
+#endif // THREAD_POOL_H
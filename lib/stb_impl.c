@@ -1,5 +1,17 @@
 // lib/stb_impl.c
+#include "buffer_pool.h"
+
+// Los buffers de pixeles de stb salen del pool y se reutilizan entre imágenes
+#define STBI_MALLOC(sz) buffer_pool_alloc(sz)
+#define STBI_REALLOC(p, newsz) buffer_pool_realloc(p, newsz)
+#define STBI_FREE(p) buffer_pool_free(p)
+#define STBIW_MALLOC(sz) buffer_pool_alloc(sz)
+#define STBIW_REALLOC(p, newsz) buffer_pool_realloc(p, newsz)
+#define STBIW_FREE(p) buffer_pool_free(p)
+
 #define STB_IMAGE_IMPLEMENTATION
+// Mismo límite que valida file_handler antes de decodificar
+#define STBI_MAX_DIMENSIONS 10000
 #include "stb/stb_image.h"
 
 #define STB_IMAGE_WRITE_IMPLEMENTATION
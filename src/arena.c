@@ -0,0 +1,145 @@
+#include "arena.h"
+#include "buffer_pool.h"
+#include "logger.h"
+
+struct arena_chunk
+{
+    struct arena_chunk *next;
+    size_t capacity;
+    size_t used;
+};
+
+// Los datos empiezan tras la cabecera, redondeada a la alineación
+#define CHUNK_HEADER_SIZE ((sizeof(arena_chunk_t) + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1))
+#define ALIGN_UP(n) (((n) + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1))
+
+// Estadísticas globales (atómicas, las actualizan todos los reactores)
+static unsigned long stat_requests = 0;
+static unsigned long long stat_total_peak = 0;
+static size_t stat_max_peak = 0;
+static size_t stat_max_reserved = 0;
+
+// Los bloques salen del pool de buffers: los bodies grandes reutilizan
+// bloques ya mapeados en lugar de ir a mmap en cada petición
+static arena_chunk_t *new_chunk(arena_t *arena, size_t capacity)
+{
+    arena_chunk_t *chunk = buffer_pool_alloc(CHUNK_HEADER_SIZE + capacity);
+    if (!chunk)
+        return NULL;
+
+    chunk->capacity = capacity;
+    chunk->used = 0;
+    arena->reserved += CHUNK_HEADER_SIZE + capacity;
+    arena->chunk_count++;
+    return chunk;
+}
+
+static void update_max(size_t *target, size_t value)
+{
+    size_t current = __atomic_load_n(target, __ATOMIC_RELAXED);
+    while (value > current &&
+           !__atomic_compare_exchange_n(target, &current, value, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    {
+    }
+}
+
+static void free_chunks(arena_t *arena)
+{
+    arena_chunk_t *chunk = arena->chunks;
+    while (chunk)
+    {
+        arena_chunk_t *next = chunk->next;
+        buffer_pool_free(chunk);
+        chunk = next;
+    }
+
+    arena->chunks = NULL;
+    arena->used = 0;
+    arena->reserved = 0;
+    arena->chunk_count = 0;
+}
+
+void arena_init(arena_t *arena)
+{
+    arena->chunks = NULL;
+    arena->used = 0;
+    arena->reserved = 0;
+    arena->chunk_count = 0;
+    arena->peak_used = 0;
+    arena->peak_reserved = 0;
+}
+
+void *arena_alloc(arena_t *arena, size_t size)
+{
+    size_t aligned = ALIGN_UP(size ? size : 1);
+    arena_chunk_t *chunk = arena->chunks;
+
+    if (!chunk || chunk->capacity - chunk->used < aligned)
+    {
+        if (aligned > ARENA_CHUNK_SIZE / 2)
+        {
+            // Bloque propio detrás del activo: el resto del activo sigue sirviendo reservas chicas
+            arena_chunk_t *large = new_chunk(arena, aligned);
+            if (!large)
+                return NULL;
+            large->used = aligned;
+            if (chunk)
+            {
+                large->next = chunk->next;
+                chunk->next = large;
+            }
+            else
+            {
+                large->next = NULL;
+                arena->chunks = large;
+            }
+            arena->used += aligned;
+            return (unsigned char *)large + CHUNK_HEADER_SIZE;
+        }
+
+        chunk = new_chunk(arena, ARENA_CHUNK_SIZE);
+        if (!chunk)
+            return NULL;
+        chunk->next = arena->chunks;
+        arena->chunks = chunk;
+    }
+
+    void *ptr = (unsigned char *)chunk + CHUNK_HEADER_SIZE + chunk->used;
+    chunk->used += aligned;
+    arena->used += aligned;
+    return ptr;
+}
+
+void arena_reset(arena_t *arena)
+{
+    if (arena->used > arena->peak_used)
+        arena->peak_used = arena->used;
+    if (arena->reserved > arena->peak_reserved)
+        arena->peak_reserved = arena->reserved;
+    free_chunks(arena);
+}
+
+void arena_release(arena_t *arena)
+{
+    arena_reset(arena);
+
+    if (arena->peak_reserved > 0)
+    {
+        LOG_DEBUG("Arena liberada: pico %zu bytes, %zu reservados", arena->peak_used, arena->peak_reserved);
+
+        __atomic_add_fetch(&stat_requests, 1, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&stat_total_peak, arena->peak_used, __ATOMIC_RELAXED);
+        update_max(&stat_max_peak, arena->peak_used);
+        update_max(&stat_max_reserved, arena->peak_reserved);
+    }
+
+    arena_init(arena);
+}
+
+void arena_get_stats(arena_stats_t *stats)
+{
+    stats->requests = __atomic_load_n(&stat_requests, __ATOMIC_RELAXED);
+    stats->total_peak = __atomic_load_n(&stat_total_peak, __ATOMIC_RELAXED);
+    stats->max_peak = __atomic_load_n(&stat_max_peak, __ATOMIC_RELAXED);
+    stats->max_reserved = __atomic_load_n(&stat_max_reserved, __ATOMIC_RELAXED);
+}
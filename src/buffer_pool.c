@@ -0,0 +1,313 @@
+#include "buffer_pool.h"
+#include "logger.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+// Cabecera delante de cada bloque; ocupa una línea de caché para que los
+// pixeles queden alineados a 64 bytes
+#define HEADER_SIZE 64
+#define MIN_CLASS_SHIFT 16 // 64 KB
+// Bloques más grandes que la última clase se mapean y liberan sin pool
+#define CLASS_DIRECT -1
+#define CLASS_MALLOC -2
+#define HUGEPAGE_SIZE (2 * 1024 * 1024)
+// Lo que cada hilo retiene sin tocar el mutex global: solo bloques medianos
+// (franjas, buffers de salida); los de pixeles completos van a la lista global
+#define THREAD_CACHE_BLOCKS 2
+#define THREAD_CACHE_MAX_CLASS 7 // 8 MB
+#define THREAD_CACHE_MAX_BYTES (16UL * 1024 * 1024)
+#define DEFAULT_MAX_CACHED_BYTES (256UL * 1024 * 1024)
+
+typedef struct block_header
+{
+    struct block_header *next; // Enlace en listas libres
+    size_t capacity;           // Bytes utilizables tras la cabecera
+    size_t mapped_size;        // Bytes mapeados (cabecera incluida)
+    int size_class;
+} block_header_t;
+
+typedef struct
+{
+    block_header_t *blocks[BUFFER_POOL_CLASSES][THREAD_CACHE_BLOCKS];
+    int counts[BUFFER_POOL_CLASSES];
+    size_t bytes;
+} thread_cache_t;
+
+// Listas libres globales por clase
+static block_header_t *global_free[BUFFER_POOL_CLASSES];
+static size_t global_cached_bytes = 0;
+static pthread_mutex_t global_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static size_t max_cached_bytes = DEFAULT_MAX_CACHED_BYTES;
+static int hugepages_enabled = 0;
+
+static pthread_key_t cache_key;
+static pthread_once_t cache_once = PTHREAD_ONCE_INIT;
+
+// Estadísticas (atómicas, las actualizan todos los hilos)
+static unsigned long stat_hits = 0;
+static unsigned long stat_misses = 0;
+static unsigned long stat_releases = 0;
+static unsigned long stat_small_allocs = 0;
+static size_t stat_cached_bytes = 0;
+static size_t stat_mapped_bytes = 0;
+
+static inline block_header_t *header_of(void *ptr)
+{
+    return (block_header_t *)((unsigned char *)ptr - HEADER_SIZE);
+}
+
+static inline void *payload_of(block_header_t *header)
+{
+    return (unsigned char *)header + HEADER_SIZE;
+}
+
+// Clase más pequeña cuyo bloque alcanza para size bytes, o CLASS_DIRECT
+static int size_class_for(size_t size)
+{
+    size_t total = size + HEADER_SIZE;
+    int size_class = 0;
+    while (size_class < BUFFER_POOL_CLASSES && ((size_t)1 << (MIN_CLASS_SHIFT + size_class)) < total)
+        size_class++;
+    return size_class < BUFFER_POOL_CLASSES ? size_class : CLASS_DIRECT;
+}
+
+static void unmap_block(block_header_t *header)
+{
+    __atomic_sub_fetch(&stat_mapped_bytes, header->mapped_size, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&stat_releases, 1, __ATOMIC_RELAXED);
+    munmap(header, header->mapped_size);
+}
+
+// Mapear un bloque nuevo; con hugepages se alinea a 2 MB recortando los
+// extremos para que el kernel pueda respaldarlo con páginas grandes
+static block_header_t *map_block(size_t mapped_size, int size_class)
+{
+    int huge = hugepages_enabled && mapped_size >= HUGEPAGE_SIZE;
+    size_t request = huge ? mapped_size + HUGEPAGE_SIZE : mapped_size;
+
+    unsigned char *base = mmap(NULL, request, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED)
+        return NULL;
+
+    if (huge)
+    {
+        uintptr_t aligned = ((uintptr_t)base + HUGEPAGE_SIZE - 1) & ~(uintptr_t)(HUGEPAGE_SIZE - 1);
+        size_t head = aligned - (uintptr_t)base;
+        size_t tail = request - head - mapped_size;
+        if (head)
+            munmap(base, head);
+        if (tail)
+            munmap((unsigned char *)aligned + mapped_size, tail);
+        base = (unsigned char *)aligned;
+        madvise(base, mapped_size, MADV_HUGEPAGE);
+    }
+
+    block_header_t *header = (block_header_t *)base;
+    header->next = NULL;
+    header->capacity = mapped_size - HEADER_SIZE;
+    header->mapped_size = mapped_size;
+    header->size_class = size_class;
+    __atomic_add_fetch(&stat_mapped_bytes, mapped_size, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&stat_misses, 1, __ATOMIC_RELAXED);
+    return header;
+}
+
+// Dejar un bloque en la lista global o devolverlo al sistema si no cabe
+static void push_global(block_header_t *header)
+{
+    int keep = 0;
+
+    pthread_mutex_lock(&global_mutex);
+    if (global_cached_bytes + header->mapped_size <= max_cached_bytes)
+    {
+        header->next = global_free[header->size_class];
+        global_free[header->size_class] = header;
+        global_cached_bytes += header->mapped_size;
+        keep = 1;
+    }
+    pthread_mutex_unlock(&global_mutex);
+
+    if (keep)
+        __atomic_add_fetch(&stat_cached_bytes, header->mapped_size, __ATOMIC_RELAXED);
+    else
+        unmap_block(header);
+}
+
+static block_header_t *pop_global(int size_class)
+{
+    pthread_mutex_lock(&global_mutex);
+    block_header_t *header = global_free[size_class];
+    if (header)
+    {
+        global_free[size_class] = header->next;
+        global_cached_bytes -= header->mapped_size;
+    }
+    pthread_mutex_unlock(&global_mutex);
+
+    if (header)
+        __atomic_sub_fetch(&stat_cached_bytes, header->mapped_size, __ATOMIC_RELAXED);
+    return header;
+}
+
+// Al terminar un hilo sus bloques pasan a la lista global
+static void flush_thread_cache(void *data)
+{
+    thread_cache_t *cache = (thread_cache_t *)data;
+    for (int c = 0; c < BUFFER_POOL_CLASSES; c++)
+    {
+        for (int i = 0; i < cache->counts[c]; i++)
+        {
+            __atomic_sub_fetch(&stat_cached_bytes, cache->blocks[c][i]->mapped_size, __ATOMIC_RELAXED);
+            push_global(cache->blocks[c][i]);
+        }
+    }
+    free(cache);
+}
+
+static void create_cache_key(void)
+{
+    pthread_key_create(&cache_key, flush_thread_cache);
+}
+
+static thread_cache_t *get_thread_cache(void)
+{
+    pthread_once(&cache_once, create_cache_key);
+
+    thread_cache_t *cache = pthread_getspecific(cache_key);
+    if (!cache)
+    {
+        cache = calloc(1, sizeof(thread_cache_t));
+        if (cache && pthread_setspecific(cache_key, cache) != 0)
+        {
+            free(cache);
+            cache = NULL;
+        }
+    }
+    return cache;
+}
+
+void buffer_pool_configure(size_t max_bytes, int use_hugepages)
+{
+    pthread_mutex_lock(&global_mutex);
+    max_cached_bytes = max_bytes;
+    hugepages_enabled = use_hugepages ? 1 : 0;
+    pthread_mutex_unlock(&global_mutex);
+
+    LOG_INFO("Pool de buffers: hasta %zu MB retenidos, hugepages %s", max_bytes / (1024 * 1024),
+             use_hugepages ? "activas" : "desactivadas");
+}
+
+void *buffer_pool_alloc(size_t size)
+{
+    if (size < BUFFER_POOL_MIN_SIZE)
+    {
+        block_header_t *header = malloc(HEADER_SIZE + size);
+        if (!header)
+            return NULL;
+        header->capacity = size;
+        header->mapped_size = 0;
+        header->size_class = CLASS_MALLOC;
+        __atomic_add_fetch(&stat_small_allocs, 1, __ATOMIC_RELAXED);
+        return payload_of(header);
+    }
+
+    int size_class = size_class_for(size);
+    if (size_class == CLASS_DIRECT)
+    {
+        block_header_t *header = map_block(size + HEADER_SIZE, CLASS_DIRECT);
+        return header ? payload_of(header) : NULL;
+    }
+
+    // Caché del hilo, luego lista global, luego mmap
+    block_header_t *header = NULL;
+    thread_cache_t *cache = get_thread_cache();
+    if (cache && size_class <= THREAD_CACHE_MAX_CLASS && cache->counts[size_class] > 0)
+    {
+        header = cache->blocks[size_class][--cache->counts[size_class]];
+        cache->bytes -= header->mapped_size;
+        __atomic_sub_fetch(&stat_cached_bytes, header->mapped_size, __ATOMIC_RELAXED);
+    }
+    if (!header)
+        header = pop_global(size_class);
+
+    if (header)
+    {
+        __atomic_add_fetch(&stat_hits, 1, __ATOMIC_RELAXED);
+        return payload_of(header);
+    }
+
+    header = map_block((size_t)1 << (MIN_CLASS_SHIFT + size_class), size_class);
+    return header ? payload_of(header) : NULL;
+}
+
+void buffer_pool_free(void *ptr)
+{
+    if (!ptr)
+        return;
+
+    block_header_t *header = header_of(ptr);
+    if (header->size_class == CLASS_MALLOC)
+    {
+        free(header);
+        return;
+    }
+    if (header->size_class == CLASS_DIRECT)
+    {
+        unmap_block(header);
+        return;
+    }
+
+    thread_cache_t *cache = header->size_class <= THREAD_CACHE_MAX_CLASS ? get_thread_cache() : NULL;
+    if (cache && cache->counts[header->size_class] < THREAD_CACHE_BLOCKS &&
+        cache->bytes + header->mapped_size <= THREAD_CACHE_MAX_BYTES)
+    {
+        cache->blocks[header->size_class][cache->counts[header->size_class]++] = header;
+        cache->bytes += header->mapped_size;
+        __atomic_add_fetch(&stat_cached_bytes, header->mapped_size, __ATOMIC_RELAXED);
+        return;
+    }
+
+    push_global(header);
+}
+
+void *buffer_pool_realloc(void *ptr, size_t size)
+{
+    if (!ptr)
+        return buffer_pool_alloc(size);
+
+    block_header_t *header = header_of(ptr);
+    if (size <= header->capacity)
+        return ptr;
+
+    // Los pequeños siguen en malloc mientras no crucen el umbral
+    if (header->size_class == CLASS_MALLOC && size < BUFFER_POOL_MIN_SIZE)
+    {
+        block_header_t *grown = realloc(header, HEADER_SIZE + size);
+        if (!grown)
+            return NULL;
+        grown->capacity = size;
+        return payload_of(grown);
+    }
+
+    void *new_ptr = buffer_pool_alloc(size);
+    if (!new_ptr)
+        return NULL;
+    memcpy(new_ptr, ptr, header->capacity);
+    buffer_pool_free(ptr);
+    return new_ptr;
+}
+
+void buffer_pool_get_stats(buffer_pool_stats_t *stats)
+{
+    stats->hits = __atomic_load_n(&stat_hits, __ATOMIC_RELAXED);
+    stats->misses = __atomic_load_n(&stat_misses, __ATOMIC_RELAXED);
+    stats->releases = __atomic_load_n(&stat_releases, __ATOMIC_RELAXED);
+    stats->small_allocs = __atomic_load_n(&stat_small_allocs, __ATOMIC_RELAXED);
+    stats->cached_bytes = __atomic_load_n(&stat_cached_bytes, __ATOMIC_RELAXED);
+    stats->mapped_bytes = __atomic_load_n(&stat_mapped_bytes, __ATOMIC_RELAXED);
+    stats->hugepages = hugepages_enabled;
+}
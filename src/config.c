@@ -9,6 +9,9 @@ void set_default_config(void) {
     strcpy(server_config.log_level, "INFO");
     server_config.max_connections = 10;
     server_config.thread_pool_size = 4;
+    server_config.reactor_threads = 2;
+    server_config.reuseport_listeners = 0;
+    server_config.compute_threads = 0;
     
     // Rutas por defecto
     strcpy(server_config.image_base_path, "/var/imageserver/images");
@@ -22,6 +25,10 @@ void set_default_config(void) {
     server_config.max_image_size_mb = 50;
     strcpy(server_config.supported_formats, "jpg,jpeg,png,gif");
     server_config.histogram_bins = 256;
+    server_config.png_compression_level = 4;
+    server_config.buffer_pool_mb = 256;
+    server_config.buffer_pool_hugepages = 0;
+    server_config.memory_job_budget_mb = 256;
 }
 
 // Función auxiliar para eliminar espacios en blanco
@@ -85,6 +92,15 @@ int load_config(const char* config_file) {
             else if (strcmp(key, "THREAD_POOL_SIZE") == 0) {
                 server_config.thread_pool_size = atoi(value);
             }
+            else if (strcmp(key, "REACTOR_THREADS") == 0) {
+                server_config.reactor_threads = atoi(value);
+            }
+            else if (strcmp(key, "REUSEPORT_LISTENERS") == 0) {
+                server_config.reuseport_listeners = atoi(value);
+            }
+            else if (strcmp(key, "COMPUTE_THREADS") == 0) {
+                server_config.compute_threads = atoi(value);
+            }
             else if (strcmp(key, "IMAGE_BASE_PATH") == 0) {
                 strcpy(server_config.image_base_path, value);
             }
@@ -112,6 +128,18 @@ int load_config(const char* config_file) {
             else if (strcmp(key, "HISTOGRAM_BINS") == 0) {
                 server_config.histogram_bins = atoi(value);
             }
+            else if (strcmp(key, "PNG_COMPRESSION_LEVEL") == 0) {
+                server_config.png_compression_level = atoi(value);
+            }
+            else if (strcmp(key, "BUFFER_POOL_MB") == 0) {
+                server_config.buffer_pool_mb = atoi(value);
+            }
+            else if (strcmp(key, "BUFFER_POOL_HUGEPAGES") == 0) {
+                server_config.buffer_pool_hugepages = atoi(value);
+            }
+            else if (strcmp(key, "MEMORY_JOB_BUDGET_MB") == 0) {
+                server_config.memory_job_budget_mb = atoi(value);
+            }
         }
     }
     
@@ -127,6 +155,13 @@ void print_config(void) {
     printf("Nivel de Log: %s\n", server_config.log_level);
     printf("Max Conexiones: %d\n", server_config.max_connections);
     printf("Thread Pool: %d\n", server_config.thread_pool_size);
+    printf("Reactores de red: %d\n", server_config.reactor_threads);
+    printf("Listeners SO_REUSEPORT: %s\n", server_config.reuseport_listeners ? "sí" : "no");
+    if (server_config.compute_threads > 0) {
+        printf("Hilos de cómputo: %d\n", server_config.compute_threads);
+    } else {
+        printf("Hilos de cómputo: automático (uno por CPU)\n");
+    }
     printf("\nRutas:\n");
     printf("  Base: %s\n", server_config.image_base_path);
     printf("  Procesadas: %s\n", server_config.processed_path);
@@ -138,6 +173,10 @@ void print_config(void) {
     printf("  Tamaño máximo: %d MB\n", server_config.max_image_size_mb);
     printf("  Formatos: %s\n", server_config.supported_formats);
     printf("  Histogram bins: %d\n", server_config.histogram_bins);
+    printf("  Compresión PNG: nivel %d\n", server_config.png_compression_level);
+    printf("  Pool de buffers: %d MB, hugepages %s\n", server_config.buffer_pool_mb,
+           server_config.buffer_pool_hugepages ? "sí" : "no");
+    printf("  Jobs en memoria: hasta %d MB\n", server_config.memory_job_budget_mb);
     printf("================================\n\n");
 }
 
@@ -158,6 +197,31 @@ int validate_config(void) {
         return 0;
     }
     
+    if (server_config.reactor_threads <= 0 || server_config.reactor_threads > 64) {
+        printf("Error: Reactor threads inválido (%d)\n", server_config.reactor_threads);
+        return 0;
+    }
+    
+    if (server_config.compute_threads < 0 || server_config.compute_threads > 256) {
+        printf("Error: Compute threads inválido (%d)\n", server_config.compute_threads);
+        return 0;
+    }
+    
+    if (server_config.png_compression_level < 0 || server_config.png_compression_level > 9) {
+        printf("Error: Nivel de compresión PNG inválido (%d). Debe estar entre 0-9\n", server_config.png_compression_level);
+        return 0;
+    }
+    
+    if (server_config.buffer_pool_mb < 0 || server_config.buffer_pool_mb > 65536) {
+        printf("Error: Tamaño del pool de buffers inválido (%d MB)\n", server_config.buffer_pool_mb);
+        return 0;
+    }
+    
+    if (server_config.memory_job_budget_mb < 0 || server_config.memory_job_budget_mb > 65536) {
+        printf("Error: Presupuesto de jobs en memoria inválido (%d MB)\n", server_config.memory_job_budget_mb);
+        return 0;
+    }
+    
     printf("Configuración validada correctamente\n");
     return 1;
 }
@@ -1,10 +1,16 @@
 #include <dirent.h>
+#include <fcntl.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/vfs.h>
+#include <linux/magic.h>
+#include <limits.h>
 #include "config.h"
 #include "logger.h"
 #include "file_handler.h"
 #include "image_processor.h"
 #include "priority_queue.h"
+#include "scanner.h"
 
 static int temp_file_counter = 0;
 
@@ -45,6 +51,42 @@ int is_supported_format(const char *filename)
             strcmp(ext_lower, "gif") == 0);
 }
 
+// Detectar formato por magic bytes
+image_format_t detect_image_format(const unsigned char *data, size_t size)
+{
+    static const unsigned char png_signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+
+    if (!data)
+        return IMAGE_FORMAT_UNKNOWN;
+
+    // JPEG: marcador SOI (FF D8) seguido del inicio de otro marcador
+    if (size >= 3 && data[0] == 0xFF && data[1] == 0xD8 && data[2] == 0xFF)
+        return IMAGE_FORMAT_JPEG;
+
+    if (size >= sizeof(png_signature) && memcmp(data, png_signature, sizeof(png_signature)) == 0)
+        return IMAGE_FORMAT_PNG;
+
+    if (size >= 6 && (memcmp(data, "GIF87a", 6) == 0 || memcmp(data, "GIF89a", 6) == 0))
+        return IMAGE_FORMAT_GIF;
+
+    return IMAGE_FORMAT_UNKNOWN;
+}
+
+const char *image_format_name(image_format_t format)
+{
+    switch (format)
+    {
+    case IMAGE_FORMAT_JPEG:
+        return "jpeg";
+    case IMAGE_FORMAT_PNG:
+        return "png";
+    case IMAGE_FORMAT_GIF:
+        return "gif";
+    default:
+        return "unknown";
+    }
+}
+
 // Generar nombre único para archivo temporal
 void generate_temp_filename(char *temp_filename, size_t size, const char *original_filename)
 {
@@ -127,150 +169,257 @@ int extract_filename_from_disposition(const char *disposition, char *filename, s
     return (i > 0) ? 1 : 0;
 }
 
-int parse_multipart_data(const char *data, size_t data_len, const char *boundary,
-                         file_upload_info_t *upload_info)
+// Buscar una secuencia de bytes en datos binarios (no se detiene en NUL)
+static const char *find_bytes(const char *data, size_t data_len, const char *needle, size_t needle_len)
 {
+    return scan_find(data, data_len, needle, needle_len);
+}
 
-    if (!data || !boundary || !upload_info || data_len == 0)
+// Procesar los headers de una parte (Content-Disposition y Content-Type)
+static int parse_part_headers(multipart_parser_t *parser, const char *part_headers, size_t headers_len)
+{
+    // Copia acotada de los headers de la parte (nunca de los datos del archivo)
+    char headers[MAX_PART_HEADERS_SIZE + 1];
+    if (headers_len > MAX_PART_HEADERS_SIZE)
     {
-        LOG_FILE_ERROR("Parámetros inválidos para parsing multipart");
-        return FILE_UPLOAD_ERROR_INVALID_PARAMS;
+        LOG_FILE_ERROR("Headers de parte demasiado largos: %zu bytes", headers_len);
+        return FILE_UPLOAD_ERROR_PARSE_FAILED;
     }
+    memcpy(headers, part_headers, headers_len);
+    headers[headers_len] = '\0';
 
-    // Limpiar estructura
-    memset(upload_info, 0, sizeof(file_upload_info_t));
-
-    // Construir boundary completo
-    char full_boundary[MAX_BOUNDARY_SIZE + 4];
-    snprintf(full_boundary, sizeof(full_boundary), "--%s", boundary);
-
-    // Construir boundary de cierre
-    char closing_boundary[MAX_BOUNDARY_SIZE + 6];
-    snprintf(closing_boundary, sizeof(closing_boundary), "--%s--", boundary);
+    LOG_FILE_DEBUG("Headers de parte (%zu bytes): %s", headers_len, headers);
 
-    LOG_FILE_DEBUG("Buscando boundary: %s", full_boundary);
-    LOG_FILE_DEBUG("Boundary de cierre: %s", closing_boundary);
+    // Solo interesa la primera parte con filename
+    parser->in_file_part = 0;
+    if (parser->file_found)
+    {
+        return FILE_UPLOAD_SUCCESS;
+    }
 
-    // Buscar el primer boundary
-    const char *boundary_start = strstr(data, full_boundary);
-    if (!boundary_start)
+    // Parsear Content-Disposition para obtener filename
+    file_upload_info_t *upload_info = parser->upload_info;
+    if (!extract_filename_from_disposition(headers,
+                                           upload_info->original_filename,
+                                           sizeof(upload_info->original_filename)))
     {
-        LOG_FILE_ERROR("No se encontró boundary inicial");
-        return FILE_UPLOAD_ERROR_NO_BOUNDARY;
+        LOG_FILE_DEBUG("Parte sin filename, ignorando");
+        return FILE_UPLOAD_SUCCESS;
     }
+    parser->in_file_part = 1;
 
-    // Buscar el boundary de cierre
-    const char *closing_boundary_start = strstr(data, closing_boundary);
-    if (!closing_boundary_start)
+    // Extraer Content-Type
+    const char *content_type_line = strstr(headers, "Content-Type:");
+    if (content_type_line)
     {
-        // Si no hay boundary de cierre, buscar el siguiente boundary
-        const char *next_boundary = strstr(boundary_start + strlen(full_boundary), full_boundary);
-        if (next_boundary)
-        {
-            closing_boundary_start = next_boundary;
-            LOG_FILE_DEBUG("Usando siguiente boundary como cierre");
-        }
-        else
+        const char *type_start = content_type_line + strlen("Content-Type:");
+        while (*type_start == ' ' || *type_start == '\t')
+            type_start++;
+
+        size_t type_len = strcspn(type_start, "\r\n");
+        if (type_len < sizeof(upload_info->content_type))
         {
-            // Usar final de datos menos margen de seguridad
-            closing_boundary_start = data + data_len - 10;
-            LOG_FILE_DEBUG("Usando final de datos como boundary de cierre");
+            memcpy(upload_info->content_type, type_start, type_len);
+            upload_info->content_type[type_len] = '\0';
         }
     }
 
-    // Posición después del primer boundary + CRLF
-    const char *headers_start = boundary_start + strlen(full_boundary);
-    if (*headers_start == '\r')
-        headers_start++;
-    if (*headers_start == '\n')
-        headers_start++;
+    return FILE_UPLOAD_SUCCESS;
+}
 
-    // Buscar fin de headers (doble CRLF)
-    const char *headers_end = strstr(headers_start, "\r\n\r\n");
-    if (!headers_end)
+int multipart_parser_init(multipart_parser_t *parser, const char *boundary,
+                          file_upload_info_t *upload_info)
+{
+    if (!parser || !boundary || !upload_info || strlen(boundary) > MAX_BOUNDARY_SIZE)
     {
-        headers_end = strstr(headers_start, "\n\n");
-        if (!headers_end)
-        {
-            LOG_FILE_ERROR("No se encontró fin de headers");
-            return FILE_UPLOAD_ERROR_PARSE_FAILED;
-        }
-        headers_end += 2; // Skip \n\n
+        return FILE_UPLOAD_ERROR_INVALID_PARAMS;
     }
-    else
+
+    memset(parser, 0, sizeof(*parser));
+    memset(upload_info, 0, sizeof(file_upload_info_t));
+
+    // Delimitador completo: CRLF--boundary (el primero puede venir sin CRLF)
+    parser->delimiter_len = snprintf(parser->delimiter, sizeof(parser->delimiter),
+                                     "\r\n--%s", boundary);
+    parser->state = MULTIPART_PREAMBLE;
+    parser->upload_info = upload_info;
+
+    LOG_FILE_DEBUG("Buscando boundary: %s", parser->delimiter + 2);
+    return FILE_UPLOAD_SUCCESS;
+}
+
+// Analizar lo que siga a un delimitador: "--" cierra, CRLF abre otra parte
+static int parse_after_delimiter(multipart_parser_t *parser, const char *data, size_t available,
+                                 size_t after)
+{
+    if (available - after < 2)
     {
-        headers_end += 4; // Skip \r\n\r\n
+        return 0; // Faltan datos
     }
 
-    // Extraer y procesar headers
-    size_t headers_len = headers_end - headers_start;
-    char *headers = malloc(headers_len + 1);
-    if (!headers)
+    if (data[after] == '-' && data[after + 1] == '-')
     {
-        LOG_FILE_ERROR("Error de memoria allocando headers");
-        return FILE_UPLOAD_ERROR_PARSE_FAILED;
+        parser->state = MULTIPART_DONE;
+        return 1;
     }
 
-    strncpy(headers, headers_start, headers_len);
-    headers[headers_len] = '\0';
+    if (data[after] == '\r' && data[after + 1] == '\n')
+    {
+        parser->state = MULTIPART_PART_HEADERS;
+        parser->part_start = after + 2;
+        parser->scanned = parser->part_start;
+        return 1;
+    }
 
-    LOG_FILE_DEBUG("Headers extraídos (%zu bytes): %s", headers_len, headers);
+    LOG_FILE_ERROR("Delimitador multipart malformado");
+    parser->state = MULTIPART_ERROR;
+    return -1;
+}
 
-    // Parsear Content-Disposition para obtener filename
-    if (!extract_filename_from_disposition(headers,
-                                           upload_info->original_filename,
-                                           sizeof(upload_info->original_filename)))
+int multipart_parser_feed(multipart_parser_t *parser, const char *data, size_t available)
+{
+    if (!parser || !data)
     {
-        LOG_FILE_ERROR("No se pudo extraer filename");
-        free(headers);
-        return FILE_UPLOAD_ERROR_PARSE_FAILED;
+        return -1;
     }
 
-    // Extraer Content-Type
-    const char *content_type_line = strstr(headers, "Content-Type:");
-    if (content_type_line)
+    // Cada byte se examina una vez, más un solapamiento de delimiter_len entre llamadas
+    while (parser->scanned < available)
     {
-        const char *type_start = content_type_line + strlen("Content-Type:");
-        while (*type_start == ' ' || *type_start == '\t')
-            type_start++;
+        switch (parser->state)
+        {
+        case MULTIPART_PREAMBLE:
+        {
+            // El primer boundary no lleva CRLF delante
+            const char *needle = parser->delimiter + 2;
+            size_t needle_len = parser->delimiter_len - 2;
+            size_t from = parser->scanned >= needle_len ? parser->scanned - needle_len + 1 : 0;
 
-        const char *type_end = strchr(type_start, '\r');
-        if (!type_end)
-            type_end = strchr(type_start, '\n');
-        if (!type_end)
-            type_end = type_start + strlen(type_start);
+            const char *match = find_bytes(data + from, available - from, needle, needle_len);
+            if (!match)
+            {
+                parser->scanned = available;
+                return 0;
+            }
 
-        size_t type_len = type_end - type_start;
-        if (type_len < sizeof(upload_info->content_type))
+            parser->scanned = (match - data) + needle_len;
+            parser->state = MULTIPART_DELIMITER;
+            break;
+        }
+
+        case MULTIPART_DELIMITER:
         {
-            strncpy(upload_info->content_type, type_start, type_len);
-            upload_info->content_type[type_len] = '\0';
+            int result = parse_after_delimiter(parser, data, available, parser->scanned);
+            if (result <= 0)
+            {
+                return result;
+            }
+            if (parser->state == MULTIPART_DONE)
+            {
+                return 1;
+            }
+            break;
+        }
+
+        case MULTIPART_PART_HEADERS:
+        {
+            size_t from = parser->scanned >= parser->part_start + 3 ? parser->scanned - 3 : parser->part_start;
+            const char *match = find_bytes(data + from, available - from, "\r\n\r\n", 4);
+            if (!match)
+            {
+                parser->scanned = available;
+                if (available - parser->part_start > MAX_PART_HEADERS_SIZE)
+                {
+                    LOG_FILE_ERROR("No se encontró fin de headers de parte");
+                    parser->state = MULTIPART_ERROR;
+                    return -1;
+                }
+                return 0;
+            }
+
+            size_t headers_end = match - data;
+            if (parse_part_headers(parser, data + parser->part_start,
+                                   headers_end - parser->part_start) != FILE_UPLOAD_SUCCESS)
+            {
+                parser->state = MULTIPART_ERROR;
+                return -1;
+            }
+
+            parser->part_start = headers_end + 4;
+            parser->scanned = parser->part_start;
+            parser->state = MULTIPART_PART_DATA;
+            break;
+        }
+
+        case MULTIPART_PART_DATA:
+        {
+            size_t from = parser->scanned;
+            if (from >= parser->part_start + parser->delimiter_len - 1)
+                from -= parser->delimiter_len - 1;
+            else
+                from = parser->part_start;
+
+            const char *match = find_bytes(data + from, available - from,
+                                           parser->delimiter, parser->delimiter_len);
+            if (!match)
+            {
+                parser->scanned = available;
+                return 0;
+            }
+
+            // Los datos del archivo quedan en su lugar dentro del body (sin copia)
+            size_t part_end = match - data;
+            if (parser->in_file_part)
+            {
+                file_upload_info_t *upload_info = parser->upload_info;
+                upload_info->file_data = data + parser->part_start;
+                upload_info->file_size = part_end - parser->part_start;
+                parser->file_found = 1;
+                parser->in_file_part = 0;
+            }
+
+            parser->scanned = part_end + parser->delimiter_len;
+            parser->state = MULTIPART_DELIMITER;
+            break;
+        }
+
+        case MULTIPART_DONE:
+            return 1;
+
+        case MULTIPART_ERROR:
+        default:
+            return -1;
         }
     }
 
-    free(headers);
+    return parser->state == MULTIPART_DONE ? 1 : 0;
+}
 
-    // Calcular posición y tamaño de datos del archivo
-    upload_info->file_data = headers_end;
+int multipart_parser_finish(multipart_parser_t *parser)
+{
+    if (!parser || parser->state == MULTIPART_ERROR)
+    {
+        return FILE_UPLOAD_ERROR_PARSE_FAILED;
+    }
 
-    // Calcular fin de datos del archivo
-    const char *file_data_end = closing_boundary_start;
+    if (parser->state == MULTIPART_PREAMBLE)
+    {
+        LOG_FILE_ERROR("No se encontró boundary inicial");
+        return FILE_UPLOAD_ERROR_NO_BOUNDARY;
+    }
 
-    // Retroceder para eliminar CRLF antes del boundary de cierre
-    while (file_data_end > upload_info->file_data &&
-           (*(file_data_end - 1) == '\r' || *(file_data_end - 1) == '\n'))
+    file_upload_info_t *upload_info = parser->upload_info;
+    if (!parser->file_found)
     {
-        file_data_end--;
+        LOG_FILE_ERROR("No se encontró una parte de archivo completa");
+        return FILE_UPLOAD_ERROR_PARSE_FAILED;
     }
 
-    upload_info->file_size = file_data_end - upload_info->file_data;
     upload_info->upload_time = time(NULL);
 
     LOG_FILE_INFO("Archivo detectado: %s", upload_info->original_filename);
     LOG_FILE_INFO("Content-Type: %s", upload_info->content_type);
     LOG_FILE_INFO("Tamaño de archivo: %zu bytes", upload_info->file_size);
-    LOG_FILE_DEBUG("Datos del archivo desde posición %ld hasta %ld",
-                   upload_info->file_data - data, file_data_end - data);
 
     // Validaciones básicas
     if (upload_info->file_size == 0)
@@ -289,6 +438,30 @@ int parse_multipart_data(const char *data, size_t data_len, const char *boundary
     return FILE_UPLOAD_SUCCESS;
 }
 
+int parse_multipart_data(const char *data, size_t data_len, const char *boundary,
+                         file_upload_info_t *upload_info)
+{
+    if (!data || !boundary || !upload_info || data_len == 0)
+    {
+        LOG_FILE_ERROR("Parámetros inválidos para parsing multipart");
+        return FILE_UPLOAD_ERROR_INVALID_PARAMS;
+    }
+
+    multipart_parser_t parser;
+    int result = multipart_parser_init(&parser, boundary, upload_info);
+    if (result != FILE_UPLOAD_SUCCESS)
+    {
+        return result;
+    }
+
+    if (multipart_parser_feed(&parser, data, data_len) < 0)
+    {
+        return FILE_UPLOAD_ERROR_PARSE_FAILED;
+    }
+
+    return multipart_parser_finish(&parser);
+}
+
 // Guardar archivo en disco
 int save_uploaded_file(const file_upload_info_t *upload_info,
                        char *saved_filepath, size_t filepath_size)
@@ -307,7 +480,8 @@ int save_uploaded_file(const file_upload_info_t *upload_info,
     }
 
     // Validar datos de imagen antes de guardar
-    if (!validate_image_data((const unsigned char *)upload_info->file_data, upload_info->file_size))
+    if (!validate_image_data((const unsigned char *)upload_info->file_data, upload_info->file_size,
+                             NULL, NULL, NULL))
     {
         LOG_FILE_ERROR("Datos de imagen inválidos para: %s", upload_info->original_filename);
         return FILE_UPLOAD_ERROR_INVALID_IMAGE;
@@ -349,14 +523,12 @@ int save_uploaded_file(const file_upload_info_t *upload_info,
     return FILE_UPLOAD_SUCCESS;
 }
 
-// Procesar upload HTTP POST completo con cola de prioridad
-int handle_file_upload_request(int client_socket, const char *request_data, size_t request_len,
-                               const char *client_ip)
+// Validar headers de un upload multipart y preparar el parser
+int begin_file_upload(int client_socket, const char *headers,
+                      multipart_parser_t *parser, file_upload_info_t *upload_info)
 {
-    LOG_INFO("Procesando upload de archivo desde %s", client_ip);
-
     // Buscar Content-Type header
-    const char *content_type_start = strstr(request_data, "Content-Type:");
+    const char *content_type_start = strstr(headers, "Content-Type:");
     if (!content_type_start)
     {
         LOG_ERROR("No se encontró Content-Type header");
@@ -432,60 +604,71 @@ int handle_file_upload_request(int client_socket, const char *request_data, size
 
     LOG_DEBUG("Boundary extraído: %s", boundary);
 
-    // Buscar inicio del cuerpo del mensaje (después de headers HTTP)
-    const char *body_start = strstr(request_data, "\r\n\r\n");
-    if (!body_start)
-    {
-        body_start = strstr(request_data, "\n\n");
-        if (!body_start)
-        {
-            LOG_ERROR("No se encontró separador de headers HTTP");
-            send_error_response(client_socket, 400, "Malformed HTTP request");
-            return -1;
-        }
-        body_start += 2;
-    }
-    else
+    // Preparar parser incremental: el body se analiza a medida que llega
+    if (multipart_parser_init(parser, boundary, upload_info) != FILE_UPLOAD_SUCCESS)
     {
-        body_start += 4;
+        LOG_ERROR("Boundary inválido: %s", boundary);
+        send_error_response(client_socket, 400, "Invalid boundary in Content-Type");
+        return -1;
     }
 
-    size_t body_len = request_len - (body_start - request_data);
-
-    // Parsear datos multipart
-    file_upload_info_t upload_info;
-    memset(&upload_info, 0, sizeof(upload_info));
+    return 0;
+}
 
-    if (parse_multipart_data(body_start, body_len, boundary, &upload_info) != 0)
+// Escribir un buffer completo en un descriptor
+static int write_all(int fd, const char *data, size_t size)
+{
+    size_t total = 0;
+    while (total < size)
     {
-        LOG_ERROR("Error parseando datos multipart");
-        send_error_response(client_socket, 400, "Failed to parse multipart data");
-        return -1;
+        ssize_t n = write(fd, data + total, size - total);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return 0;
+        total += (size_t)n;
     }
+    return 1;
+}
 
-    // Verificar formato soportado
-    if (!is_supported_format(upload_info.original_filename))
+// Abrir un spool sin nombre: memfd si el directorio temporal es tmpfs (mismo
+// almacenamiento, sin pasar por el directorio) y O_TMPFILE en otro caso
+int open_upload_spool(void)
+{
+    struct statfs fs;
+    if (statfs(server_config.temp_path, &fs) == 0 && fs.f_type == TMPFS_MAGIC)
     {
-        LOG_ERROR("Formato de archivo no soportado: %s", upload_info.original_filename);
-        send_error_response(client_socket, 400, "Unsupported file format");
-        return -1;
+        int fd = memfd_create("imageserver-upload", MFD_CLOEXEC);
+        if (fd >= 0)
+            return fd;
     }
 
-    // Verificar tamaño máximo
-    size_t max_size = server_config.max_image_size_mb * 1024 * 1024;
-    if (upload_info.file_size > max_size)
+    return open(server_config.temp_path, O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+}
+
+// Volcar un upload a disco. Preferentemente a un spool anónimo cuyo fd viaja en
+// la cola y desaparece al cerrarlo; sin soporte, a un archivo temporal con nombre
+// Retorna 0 en éxito (spool_fd >= 0 o temp_filename lleno), -1 en error (respuesta enviada)
+static int spool_upload(int client_socket, const file_upload_info_t *upload_info, int *spool_fd,
+                        char *temp_filename, size_t filename_size)
+{
+    *spool_fd = open_upload_spool();
+    if (*spool_fd >= 0)
     {
-        LOG_ERROR("Archivo demasiado grande: %zu bytes (máximo: %zu MB)",
-                  upload_info.file_size, server_config.max_image_size_mb);
-        send_error_response(client_socket, 413, "File too large");
+        if (write_all(*spool_fd, upload_info->file_data, upload_info->file_size))
+            return 0;
+
+        LOG_ERROR("Error escribiendo spool anónimo: %s", strerror(errno));
+        close(*spool_fd);
+        *spool_fd = -1;
+        send_error_response(client_socket, 500, "Failed to write temporary file");
         return -1;
     }
 
-    // Generar nombre de archivo temporal
-    char temp_filename[512];
-    generate_temp_filename(temp_filename, sizeof(temp_filename), upload_info.original_filename);
+    LOG_DEBUG("Spool anónimo no disponible en %s (%s), usando archivo con nombre", server_config.temp_path,
+              strerror(errno));
+    generate_temp_filename(temp_filename, filename_size, upload_info->original_filename);
 
-    // Guardar archivo temporal
     FILE *file = fopen(temp_filename, "wb");
     if (!file)
     {
@@ -494,77 +677,224 @@ int handle_file_upload_request(int client_socket, const char *request_data, size
         return -1;
     }
 
-    size_t written = fwrite(upload_info.file_data, 1, upload_info.file_size, file);
+    size_t written = fwrite(upload_info->file_data, 1, upload_info->file_size, file);
     fclose(file);
 
-    if (written != upload_info.file_size)
+    if (written != upload_info->file_size)
     {
-        LOG_ERROR("Error escribiendo archivo: escrito %zu de %zu bytes", written, upload_info.file_size);
+        LOG_ERROR("Error escribiendo archivo: escrito %zu de %zu bytes", written, upload_info->file_size);
         unlink(temp_filename);
         send_error_response(client_socket, 500, "Failed to write temporary file");
         return -1;
     }
 
-    // Verificar que es imagen válida
-    int width, height, channels;
-    unsigned char *img_data = stbi_load(temp_filename, &width, &height, &channels, 0);
-    if (!img_data)
+    return 0;
+}
+
+// Procesar archivo extraído del upload con cola de prioridad
+int handle_file_upload_request(int client_socket, const file_upload_info_t *upload_info,
+                               const char *client_ip)
+{
+    LOG_INFO("Procesando upload de archivo desde %s", client_ip);
+
+    // Verificar formato soportado por su contenido, no por la extensión
+    file_upload_info_t queued_info = *upload_info;
+    queued_info.image_format = detect_image_format((const unsigned char *)upload_info->file_data,
+                                                   upload_info->file_size);
+    if (queued_info.image_format == IMAGE_FORMAT_UNKNOWN)
+    {
+        LOG_ERROR("Formato de archivo no soportado (firma desconocida): %s", upload_info->original_filename);
+        send_error_response(client_socket, 400, "Unsupported file format");
+        return -1;
+    }
+
+    if (!is_supported_format(upload_info->original_filename))
     {
-        LOG_ERROR("Archivo no es una imagen válida: %s", stbi_failure_reason());
-        unlink(temp_filename);
+        LOG_WARNING("Extensión de %s no coincide con su contenido (%s)",
+                    upload_info->original_filename, image_format_name(queued_info.image_format));
+    }
+
+    // Verificar tamaño máximo
+    size_t max_size = (size_t)server_config.max_image_size_mb * 1024 * 1024;
+    if (upload_info->file_size > max_size)
+    {
+        LOG_ERROR("Archivo demasiado grande: %zu bytes (máximo: %d MB)",
+                  upload_info->file_size, server_config.max_image_size_mb);
+        send_error_response(client_socket, 413, "File too large");
+        return -1;
+    }
+
+    // Validar la imagen con su header antes de escribirla; la única decodificación
+    // completa ocurre después en el procesador
+    if (!validate_image_data((const unsigned char *)upload_info->file_data, upload_info->file_size,
+                             &queued_info.image_width, &queued_info.image_height,
+                             &queued_info.image_channels))
+    {
+        LOG_ERROR("Archivo no es una imagen válida: %s", upload_info->original_filename);
         send_error_response(client_socket, 400, "Invalid image file");
         return -1;
     }
-    stbi_image_free(img_data);
+
+    // Dentro del presupuesto el job viaja en memoria: el worker lee los bytes
+    // del body de la conexión, que sigue viva hasta enviar la respuesta
+    int in_memory = reserve_memory_job(upload_info->file_size);
+
+    char temp_filename[512];
+    int spool_fd = -1;
+    if (!in_memory)
+    {
+        // Presupuesto agotado: volcar a disco
+        if (spool_upload(client_socket, upload_info, &spool_fd, temp_filename, sizeof(temp_filename)) != 0)
+            return -1;
+
+        // El body ya está en disco: no retenerlo mientras el job espera en la cola
+        queued_info.file_data = NULL;
+        release_client_body(client_socket);
+    }
 
     // Encolar archivo para procesamiento en lugar de procesarlo directamente
-    if (enqueue_file_for_processing(&upload_info, temp_filename, client_ip, client_socket) != 0)
+    const char *queued_path = (in_memory || spool_fd >= 0) ? NULL : temp_filename;
+    if (enqueue_file_for_processing(&queued_info, queued_path, spool_fd, client_ip, client_socket) != 0)
     {
         LOG_ERROR("Error encolando archivo para procesamiento");
-        unlink(temp_filename);
+        if (in_memory)
+            release_memory_job(upload_info->file_size);
+        else if (spool_fd >= 0)
+            close(spool_fd);
+        else
+            unlink(temp_filename);
         send_error_response(client_socket, 500, "Failed to queue file for processing");
         return -1;
     }
 
-    log_client_activity(client_ip, upload_info.original_filename, "upload", "queued");
+    log_client_activity(client_ip, upload_info->original_filename, "upload", "queued");
+
+    LOG_INFO("Upload encolado %s: %s (%zu bytes) desde %s - Posición en cola: %d",
+             in_memory ? "en memoria" : (spool_fd >= 0 ? "en spool anónimo" : "en disco"),
+             upload_info->original_filename, upload_info->file_size,
+             client_ip, get_queue_size());
+
+    return 0;
+}
+
+// Procesar un upload raw que ya está completo en un spool anónimo
+int handle_raw_upload_request(int client_socket, int spool_fd, size_t size, const char *filename,
+                              const char *client_ip)
+{
+    LOG_INFO("Procesando upload raw desde %s (%zu bytes)", client_ip, size);
+
+    file_upload_info_t upload_info;
+    memset(&upload_info, 0, sizeof(upload_info));
+    strncpy(upload_info.original_filename, filename && filename[0] ? filename : "upload",
+            sizeof(upload_info.original_filename) - 1);
+    strncpy(upload_info.content_type, "application/octet-stream", sizeof(upload_info.content_type) - 1);
+    upload_info.file_size = size;
+    upload_info.upload_time = time(NULL);
+
+    size_t max_size = (size_t)server_config.max_image_size_mb * 1024 * 1024;
+    if (size == 0 || size > max_size)
+    {
+        LOG_ERROR("Tamaño de upload raw inválido: %zu bytes (máximo: %d MB)", size, server_config.max_image_size_mb);
+        send_error_response(client_socket, size ? 413 : 400, size ? "File too large" : "Empty upload");
+        close(spool_fd);
+        return -1;
+    }
+
+    // Los bytes nunca pasaron por user space: validar firma y header sobre el spool mapeado
+    void *mapped = mmap(NULL, size, PROT_READ, MAP_SHARED, spool_fd, 0);
+    if (mapped == MAP_FAILED)
+    {
+        LOG_ERROR("No se pudo mapear el spool del upload raw: %s", strerror(errno));
+        send_error_response(client_socket, 500, "Internal Server Error");
+        close(spool_fd);
+        return -1;
+    }
+
+    upload_info.image_format = detect_image_format(mapped, size);
+    int valid = upload_info.image_format != IMAGE_FORMAT_UNKNOWN &&
+                validate_image_data(mapped, size, &upload_info.image_width, &upload_info.image_height,
+                                    &upload_info.image_channels);
+    munmap(mapped, size);
+
+    if (!valid)
+    {
+        LOG_ERROR("Upload raw no es una imagen soportada: %s", upload_info.original_filename);
+        send_error_response(client_socket, 400, "Invalid image file");
+        close(spool_fd);
+        return -1;
+    }
 
-    LOG_INFO("Upload encolado: %s (%zu bytes) desde %s - Posición en cola: %d",
-             upload_info.original_filename, upload_info.file_size, client_ip, get_queue_size());
+    // Sin extensión en el nombre la salida se codifica según el formato detectado
+    if (!GET_FILE_EXTENSION(upload_info.original_filename))
+    {
+        size_t len = strlen(upload_info.original_filename);
+        snprintf(upload_info.original_filename + len, sizeof(upload_info.original_filename) - len, ".%s",
+                 upload_info.image_format == IMAGE_FORMAT_PNG ? "png" : "jpg");
+    }
+
+    if (enqueue_file_for_processing(&upload_info, NULL, spool_fd, client_ip, client_socket) != 0)
+    {
+        LOG_ERROR("Error encolando upload raw para procesamiento");
+        send_error_response(client_socket, 500, "Failed to queue file for processing");
+        close(spool_fd);
+        return -1;
+    }
 
+    log_client_activity(client_ip, upload_info.original_filename, "upload", "queued");
+    LOG_INFO("Upload raw encolado en spool anónimo: %s (%zu bytes) desde %s - Posición en cola: %d",
+             upload_info.original_filename, size, client_ip, get_queue_size());
     return 0;
 }
 
-int validate_image_data(const unsigned char *data, size_t size)
+int validate_image_data(const unsigned char *data, size_t size, int *width, int *height, int *channels)
 {
-    int width, height, channels;
+    int info_width, info_height, info_channels;
 
-    // Intentar cargar la imagen con stb_image
-    unsigned char *image_data = stbi_load_from_memory(data, (int)size, &width, &height, &channels, 0);
+    if (!data || size == 0 || size > INT_MAX)
+    {
+        LOG_FILE_ERROR("Datos de imagen vacíos o demasiado grandes (%zu bytes)", size);
+        return 0;
+    }
+
+    // Descartar por firma antes de invocar a stb_image
+    image_format_t format = detect_image_format(data, size);
+    if (format == IMAGE_FORMAT_UNKNOWN)
+    {
+        LOG_FILE_ERROR("Firma de imagen no reconocida (se aceptan JPEG, PNG y GIF)");
+        return 0;
+    }
 
-    if (!image_data)
+    // Leer solo el header con stb_image; no se reserva memoria para pixeles
+    if (!stbi_info_from_memory(data, (int)size, &info_width, &info_height, &info_channels))
     {
         const char *error = stbi_failure_reason();
-        LOG_FILE_ERROR("STB no pudo cargar imagen: %s", error ? error : "Error desconocido");
+        LOG_FILE_ERROR("STB no pudo leer el header de la imagen: %s", error ? error : "Error desconocido");
         return 0;
     }
 
     // Validar dimensiones razonables
-    if (width <= 0 || height <= 0 || width > 10000 || height > 10000)
+    if (info_width <= 0 || info_height <= 0 ||
+        info_width > MAX_IMAGE_DIMENSION || info_height > MAX_IMAGE_DIMENSION)
     {
-        LOG_FILE_ERROR("Dimensiones de imagen inválidas: %dx%d", width, height);
-        stbi_image_free(image_data);
+        LOG_FILE_ERROR("Dimensiones de imagen inválidas: %dx%d", info_width, info_height);
         return 0;
     }
 
-    if (channels < 1 || channels > 4)
+    if (info_channels < 1 || info_channels > 4)
     {
-        LOG_FILE_ERROR("Número de canales inválido: %d", channels);
-        stbi_image_free(image_data);
+        LOG_FILE_ERROR("Número de canales inválido: %d", info_channels);
         return 0;
     }
 
-    LOG_FILE_DEBUG("Imagen validada: %dx%d, %d canales", width, height, channels);
-    stbi_image_free(image_data);
+    if (width)
+        *width = info_width;
+    if (height)
+        *height = info_height;
+    if (channels)
+        *channels = info_channels;
+
+    LOG_FILE_DEBUG("Imagen validada: %s %dx%d, %d canales", image_format_name(format),
+                   info_width, info_height, info_channels);
     return 1;
 }
 
@@ -578,6 +908,17 @@ int cleanup_old_temp_files(int max_age_hours)
     time_t current_time = time(NULL);
     time_t max_age_seconds = max_age_hours * 3600;
     int files_deleted = 0;
+    int files_remaining = 0;
+
+    // Con spool anónimo no se crean archivos con nombre: tras un barrido que no
+    // dejó restos solo se vuelve a escanear si desde entonces se creó alguno
+    static int scanned_counter = -1;
+    static int pending_files = 1;
+    int counter = __atomic_load_n(&temp_file_counter, __ATOMIC_RELAXED);
+    if (!pending_files && counter == scanned_counter)
+    {
+        return 0;
+    }
 
     LOG_DEBUG("Iniciando limpieza de archivos temporales (edad máxima: %d horas)", max_age_hours);
 
@@ -637,10 +978,18 @@ int cleanup_old_temp_files(int max_age_hours)
             {
                 LOG_ERROR("Error eliminando archivo temporal: %s (%s)",
                           filepath, strerror(errno));
+                files_remaining++;
             }
         }
+        else
+        {
+            files_remaining++;
+        }
     }
 
+    scanned_counter = counter;
+    pending_files = files_remaining > 0;
+
     closedir(dir);
 
     if (files_deleted > 0)
@@ -0,0 +1,445 @@
+#include "image_kernels.h"
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define KERNELS_X86 1
+#endif
+
+// Pixeles por bloque al calcular histogramas (buffer de luminancia en el stack)
+#define HISTOGRAM_CHUNK 1024
+// Bancos de histograma: pixeles consecutivos incrementan contadores distintos
+// para no encadenar store->load sobre el mismo bin en zonas uniformes
+#define HISTOGRAM_BANKS 4
+
+// Los kernels se generan especializados para 1, 2, 3 y 4 canales: cada cuerpo
+// se escribe una vez como función always_inline con `channels` como parámetro
+// y SPECIALIZE_* lo instancia con la constante, de modo que el compilador
+// elimina las ramas por canal y desenrolla el acceso a cada pixel.
+// El despacho por número de canales ocurre una vez por llamada.
+#define KERNEL_INLINE static inline __attribute__((always_inline))
+
+typedef void (*luminance_fn_t)(const unsigned char *, size_t, unsigned char *);
+typedef void (*channel_sums_fn_t)(const unsigned char *, size_t, long long *);
+typedef void (*lut_fn_t)(unsigned char *, size_t, const unsigned char *);
+
+static const luminance_fn_t *active_luminance = NULL; // Indexado por canales (1-4)
+static kernel_impl_t active_impl = KERNEL_IMPL_SCALAR;
+static pthread_once_t kernels_once = PTHREAD_ONCE_INIT;
+
+// =============================================================================
+// REFERENCIA ESCALAR
+// =============================================================================
+
+// Luminancia en punto fijo: 299r + 587g + 114b es exacto en enteros y su
+// división entera por 1000 coincide con el cálculo en double salvo cuando la
+// suma es múltiplo de 1000 (el double puede quedar apenas por debajo del
+// entero); en ese caso se replica la fórmula original
+static inline unsigned char luminance_reference(int r, int g, int b)
+{
+    return (unsigned char)(int)(0.299 * r + 0.587 * g + 0.114 * b);
+}
+
+static inline unsigned char luminance_fixed(int r, int g, int b)
+{
+    int weighted = 299 * r + 587 * g + 114 * b;
+    int quotient = weighted / 1000;
+
+    if (quotient * 1000 == weighted)
+        return luminance_reference(r, g, b);
+    return (unsigned char)quotient;
+}
+
+KERNEL_INLINE void luminance_scalar_body(const unsigned char *pixels, size_t count, const int channels,
+                                        unsigned char *luminance)
+{
+    for (size_t i = 0; i < count; i++, pixels += channels)
+    {
+        // Escala de grises (con o sin alpha): el primer canal es la luminancia
+        luminance[i] = channels >= 3 ? luminance_fixed(pixels[0], pixels[1], pixels[2]) : pixels[0];
+    }
+}
+
+// Sumas de R, G y B (solo se instancia para 3 y 4 canales)
+KERNEL_INLINE void channel_sums_body(const unsigned char *pixels, size_t count, const int channels,
+                                    long long channel_sums[3])
+{
+    uint64_t red = 0, green = 0, blue = 0;
+
+    for (size_t i = 0; i < count; i++, pixels += channels)
+    {
+        red += pixels[0];
+        green += pixels[1];
+        blue += pixels[2];
+    }
+
+    channel_sums[0] += (long long)red;
+    channel_sums[1] += (long long)green;
+    channel_sums[2] += (long long)blue;
+}
+
+// La variante pshufb de 256 entradas (16 tablas por nibble alto) resultó más
+// lenta que las búsquedas en tabla tanto con SSE4.1 como con AVX2
+KERNEL_INLINE void lut_body(unsigned char *pixels, size_t count, const int channels,
+                           const unsigned char *lut)
+{
+    // Sin alpha todos los bytes son canales de color
+    if (channels == 1 || channels == 3)
+    {
+        size_t bytes = count * channels;
+        size_t i = 0;
+        for (; i + 4 <= bytes; i += 4)
+        {
+            pixels[i] = lut[pixels[i]];
+            pixels[i + 1] = lut[pixels[i + 1]];
+            pixels[i + 2] = lut[pixels[i + 2]];
+            pixels[i + 3] = lut[pixels[i + 3]];
+        }
+        for (; i < bytes; i++)
+        {
+            pixels[i] = lut[pixels[i]];
+        }
+        return;
+    }
+
+    // Con alpha (2 o 4 canales) el último byte de cada pixel se conserva
+    for (size_t i = 0; i < count; i++, pixels += channels)
+    {
+        pixels[0] = lut[pixels[0]];
+        if (channels == 4)
+        {
+            pixels[1] = lut[pixels[1]];
+            pixels[2] = lut[pixels[2]];
+        }
+    }
+}
+
+#define SPECIALIZE_SCALAR(CH)                                                                     \
+    static void luminance_scalar_##CH(const unsigned char *pixels, size_t count,                   \
+                                      unsigned char *luminance)                                    \
+    {                                                                                              \
+        luminance_scalar_body(pixels, count, CH, luminance);                                       \
+    }                                                                                              \
+    static void lut_##CH(unsigned char *pixels, size_t count, const unsigned char *lut)            \
+    {                                                                                              \
+        lut_body(pixels, count, CH, lut);                                                          \
+    }
+
+#define SPECIALIZE_CHANNEL_SUMS(CH)                                                               \
+    static void channel_sums_##CH(const unsigned char *pixels, size_t count, long long *sums)      \
+    {                                                                                              \
+        channel_sums_body(pixels, count, CH, sums);                                                \
+    }
+
+SPECIALIZE_SCALAR(1)
+SPECIALIZE_SCALAR(2)
+SPECIALIZE_SCALAR(3)
+SPECIALIZE_SCALAR(4)
+SPECIALIZE_CHANNEL_SUMS(3)
+SPECIALIZE_CHANNEL_SUMS(4)
+
+static const luminance_fn_t luminance_scalar[5] = {NULL, luminance_scalar_1, luminance_scalar_2,
+                                                   luminance_scalar_3, luminance_scalar_4};
+static const channel_sums_fn_t channel_sums_kernels[5] = {NULL, NULL, NULL, channel_sums_3, channel_sums_4};
+static const lut_fn_t lut_kernels[5] = {NULL, lut_1, lut_2, lut_3, lut_4};
+
+#ifdef KERNELS_X86
+
+// =============================================================================
+// SSE4.1
+// =============================================================================
+
+// Máscaras pshufb que separan cada pixel en palabras (r, g) y (b, 0) de 32 bits
+#define Z 0x80
+static const uint8_t shuffle_rg_rgba[16] = {0, Z, 1, Z, 4, Z, 5, Z, 8, Z, 9, Z, 12, Z, 13, Z};
+static const uint8_t shuffle_b_rgba[16] = {2, Z, Z, Z, 6, Z, Z, Z, 10, Z, Z, Z, 14, Z, Z, Z};
+static const uint8_t shuffle_rg_rgb[16] = {0, Z, 1, Z, 3, Z, 4, Z, 6, Z, 7, Z, 9, Z, 10, Z};
+static const uint8_t shuffle_b_rgb[16] = {2, Z, Z, Z, 5, Z, Z, Z, 8, Z, Z, Z, 11, Z, Z, Z};
+static const uint8_t shuffle_pack_dwords[16] = {0, 4, 8, 12, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z};
+#undef Z
+
+// Cociente entre 1000 de sumas ponderadas (< 2^18) vía float con corrección
+// exacta por el resto; también devuelve qué carriles tienen resto 0
+__attribute__((target("sse4.1")))
+static inline __m128i divide_by_1000_sse41(__m128i weighted, int *exact_mask)
+{
+    const __m128i thousand = _mm_set1_epi32(1000);
+    __m128i quotient = _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(weighted), _mm_set1_ps(0.001f)));
+    __m128i remainder = _mm_sub_epi32(weighted, _mm_mullo_epi32(quotient, thousand));
+
+    __m128i negative = _mm_cmpgt_epi32(_mm_setzero_si128(), remainder);
+    quotient = _mm_add_epi32(quotient, negative);
+    remainder = _mm_add_epi32(remainder, _mm_and_si128(negative, thousand));
+
+    __m128i too_big = _mm_cmpgt_epi32(remainder, _mm_set1_epi32(999));
+    quotient = _mm_sub_epi32(quotient, too_big);
+    remainder = _mm_sub_epi32(remainder, _mm_and_si128(too_big, thousand));
+
+    *exact_mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(remainder, _mm_setzero_si128())));
+    return quotient;
+}
+
+__attribute__((target("sse4.1"))) KERNEL_INLINE void luminance_sse41_body(const unsigned char *pixels, size_t count,
+                                                                          const int channels,
+                                                                          unsigned char *luminance)
+{
+    const __m128i shuffle_rg = _mm_loadu_si128((const __m128i *)(channels == 4 ? shuffle_rg_rgba : shuffle_rg_rgb));
+    const __m128i shuffle_b = _mm_loadu_si128((const __m128i *)(channels == 4 ? shuffle_b_rgba : shuffle_b_rgb));
+    const __m128i shuffle_pack = _mm_loadu_si128((const __m128i *)shuffle_pack_dwords);
+    const __m128i weights_rg = _mm_set1_epi32((587 << 16) | 299);
+    const __m128i weights_b = _mm_set1_epi32(114);
+    size_t i = 0;
+
+    // Cada iteración lee 16 bytes: con 3 canales se requieren 6 pixeles disponibles
+    for (; i + 6 <= count; i += 4)
+    {
+        const unsigned char *p = pixels + i * channels;
+        __m128i v = _mm_loadu_si128((const __m128i *)p);
+        __m128i weighted = _mm_add_epi32(_mm_madd_epi16(_mm_shuffle_epi8(v, shuffle_rg), weights_rg),
+                                         _mm_madd_epi16(_mm_shuffle_epi8(v, shuffle_b), weights_b));
+        int exact_mask;
+        __m128i quotient = divide_by_1000_sse41(weighted, &exact_mask);
+
+        uint32_t packed = (uint32_t)_mm_cvtsi128_si32(_mm_shuffle_epi8(quotient, shuffle_pack));
+        memcpy(luminance + i, &packed, sizeof(packed));
+
+        while (exact_mask)
+        {
+            int lane = __builtin_ctz(exact_mask);
+            const unsigned char *px = p + lane * channels;
+            luminance[i + lane] = luminance_reference(px[0], px[1], px[2]);
+            exact_mask &= exact_mask - 1;
+        }
+    }
+
+    luminance_scalar_body(pixels + i * channels, count - i, channels, luminance + i);
+}
+
+// =============================================================================
+// AVX2
+// =============================================================================
+
+__attribute__((target("avx2")))
+static inline __m256i divide_by_1000_avx2(__m256i weighted, int *exact_mask)
+{
+    const __m256i thousand = _mm256_set1_epi32(1000);
+    __m256i quotient = _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_cvtepi32_ps(weighted), _mm256_set1_ps(0.001f)));
+    __m256i remainder = _mm256_sub_epi32(weighted, _mm256_mullo_epi32(quotient, thousand));
+
+    __m256i negative = _mm256_cmpgt_epi32(_mm256_setzero_si256(), remainder);
+    quotient = _mm256_add_epi32(quotient, negative);
+    remainder = _mm256_add_epi32(remainder, _mm256_and_si256(negative, thousand));
+
+    __m256i too_big = _mm256_cmpgt_epi32(remainder, _mm256_set1_epi32(999));
+    quotient = _mm256_sub_epi32(quotient, too_big);
+    remainder = _mm256_sub_epi32(remainder, _mm256_and_si256(too_big, thousand));
+
+    *exact_mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(remainder, _mm256_setzero_si256())));
+    return quotient;
+}
+
+__attribute__((target("avx2"))) KERNEL_INLINE void luminance_avx2_body(const unsigned char *pixels, size_t count,
+                                                                       const int channels,
+                                                                       unsigned char *luminance)
+{
+    const __m256i shuffle_rg = _mm256_broadcastsi128_si256(
+        _mm_loadu_si128((const __m128i *)(channels == 4 ? shuffle_rg_rgba : shuffle_rg_rgb)));
+    const __m256i shuffle_b = _mm256_broadcastsi128_si256(
+        _mm_loadu_si128((const __m128i *)(channels == 4 ? shuffle_b_rgba : shuffle_b_rgb)));
+    const __m256i shuffle_pack = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)shuffle_pack_dwords));
+    const __m256i weights_rg = _mm256_set1_epi32((587 << 16) | 299);
+    const __m256i weights_b = _mm256_set1_epi32(114);
+    const size_t lane_bytes = 4 * channels; // 4 pixeles por carril de 128 bits
+    size_t i = 0;
+
+    // Cada carril lee 16 bytes: con 3 canales el segundo carril termina en el byte 28
+    for (; i + 10 <= count; i += 8)
+    {
+        const unsigned char *p = pixels + i * channels;
+        __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)p)),
+                                            _mm_loadu_si128((const __m128i *)(p + lane_bytes)), 1);
+        __m256i weighted = _mm256_add_epi32(_mm256_madd_epi16(_mm256_shuffle_epi8(v, shuffle_rg), weights_rg),
+                                            _mm256_madd_epi16(_mm256_shuffle_epi8(v, shuffle_b), weights_b));
+        int exact_mask;
+        __m256i quotient = divide_by_1000_avx2(weighted, &exact_mask);
+
+        __m256i packed = _mm256_shuffle_epi8(quotient, shuffle_pack);
+        uint32_t low = (uint32_t)_mm_cvtsi128_si32(_mm256_castsi256_si128(packed));
+        uint32_t high = (uint32_t)_mm_cvtsi128_si32(_mm256_extracti128_si256(packed, 1));
+        memcpy(luminance + i, &low, sizeof(low));
+        memcpy(luminance + i + 4, &high, sizeof(high));
+
+        while (exact_mask)
+        {
+            int lane = __builtin_ctz(exact_mask);
+            const unsigned char *px = p + lane * channels;
+            luminance[i + lane] = luminance_reference(px[0], px[1], px[2]);
+            exact_mask &= exact_mask - 1;
+        }
+    }
+
+    luminance_sse41_body(pixels + i * channels, count - i, channels, luminance + i);
+}
+
+// Con 1-2 canales la luminancia es una copia del primer canal: se usa la versión escalar
+#define SPECIALIZE_SIMD(CH)                                                                       \
+    __attribute__((target("sse4.1"))) static void luminance_sse41_##CH(const unsigned char *pixels, \
+                                                                       size_t count,              \
+                                                                       unsigned char *luminance)  \
+    {                                                                                              \
+        luminance_sse41_body(pixels, count, CH, luminance);                                        \
+    }                                                                                              \
+    __attribute__((target("avx2"))) static void luminance_avx2_##CH(const unsigned char *pixels,   \
+                                                                    size_t count,                 \
+                                                                    unsigned char *luminance)     \
+    {                                                                                              \
+        luminance_avx2_body(pixels, count, CH, luminance);                                         \
+    }
+
+SPECIALIZE_SIMD(3)
+SPECIALIZE_SIMD(4)
+
+static const luminance_fn_t luminance_sse41[5] = {NULL, luminance_scalar_1, luminance_scalar_2,
+                                                  luminance_sse41_3, luminance_sse41_4};
+static const luminance_fn_t luminance_avx2[5] = {NULL, luminance_scalar_1, luminance_scalar_2,
+                                                 luminance_avx2_3, luminance_avx2_4};
+
+#endif // KERNELS_X86
+
+// =============================================================================
+// DESPACHO
+// =============================================================================
+
+static void kernels_detect(void)
+{
+    active_luminance = luminance_scalar;
+    active_impl = KERNEL_IMPL_SCALAR;
+
+#ifdef KERNELS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        active_luminance = luminance_avx2;
+        active_impl = KERNEL_IMPL_AVX2;
+    }
+    else if (__builtin_cpu_supports("sse4.1"))
+    {
+        active_luminance = luminance_sse41;
+        active_impl = KERNEL_IMPL_SSE41;
+    }
+#endif
+}
+
+void kernel_luminance_row(const unsigned char *pixels, size_t count, int channels,
+                          unsigned char *luminance)
+{
+    pthread_once(&kernels_once, kernels_detect);
+    active_luminance[channels](pixels, count, luminance);
+}
+
+void kernel_analyze_pixels(const unsigned char *pixels, size_t count, int channels,
+                           int histogram[256], long long channel_sums[3])
+{
+    unsigned char luminance[HISTOGRAM_CHUNK];
+    uint32_t banks[HISTOGRAM_BANKS][256];
+
+    pthread_once(&kernels_once, kernels_detect);
+    memset(banks, 0, sizeof(banks));
+
+    // Despacho una vez por llamada según el número de canales
+    const luminance_fn_t luminance_kernel = active_luminance[channels];
+    const channel_sums_fn_t sums_kernel = channel_sums ? channel_sums_kernels[channels] : NULL;
+
+    while (count > 0)
+    {
+        size_t chunk = count < HISTOGRAM_CHUNK ? count : HISTOGRAM_CHUNK;
+        luminance_kernel(pixels, chunk, luminance);
+
+        // El bloque sigue en L1: las sumas no agregan otra lectura de memoria
+        if (sums_kernel)
+        {
+            sums_kernel(pixels, chunk, channel_sums);
+        }
+
+        size_t i = 0;
+        for (; i + HISTOGRAM_BANKS <= chunk; i += HISTOGRAM_BANKS)
+        {
+            banks[0][luminance[i]]++;
+            banks[1][luminance[i + 1]]++;
+            banks[2][luminance[i + 2]]++;
+            banks[3][luminance[i + 3]]++;
+        }
+        for (; i < chunk; i++)
+        {
+            banks[0][luminance[i]]++;
+        }
+
+        pixels += chunk * channels;
+        count -= chunk;
+    }
+
+    for (int bin = 0; bin < 256; bin++)
+    {
+        histogram[bin] += (int)(banks[0][bin] + banks[1][bin] + banks[2][bin] + banks[3][bin]);
+    }
+}
+
+void kernel_luminance_histogram(const unsigned char *pixels, size_t count, int channels,
+                                int histogram[256])
+{
+    kernel_analyze_pixels(pixels, count, channels, histogram, NULL);
+}
+
+void kernel_apply_lut(unsigned char *pixels, size_t count, int channels, const unsigned char lut[256])
+{
+    lut_kernels[channels](pixels, count, lut);
+}
+
+int image_kernels_set_implementation(kernel_impl_t impl)
+{
+    pthread_once(&kernels_once, kernels_detect);
+
+    switch (impl)
+    {
+    case KERNEL_IMPL_AUTO:
+        kernels_detect();
+        return 1;
+    case KERNEL_IMPL_SCALAR:
+        active_luminance = luminance_scalar;
+        break;
+#ifdef KERNELS_X86
+    case KERNEL_IMPL_SSE41:
+        if (!__builtin_cpu_supports("sse4.1"))
+            return 0;
+        active_luminance = luminance_sse41;
+        break;
+    case KERNEL_IMPL_AVX2:
+        if (!__builtin_cpu_supports("avx2"))
+            return 0;
+        active_luminance = luminance_avx2;
+        break;
+#endif
+    default:
+        return 0;
+    }
+
+    active_impl = impl;
+    return 1;
+}
+
+const char *image_kernels_implementation_name(void)
+{
+    pthread_once(&kernels_once, kernels_detect);
+
+    switch (active_impl)
+    {
+    case KERNEL_IMPL_AVX2:
+        return "avx2";
+    case KERNEL_IMPL_SSE41:
+        return "sse4.1";
+    default:
+        return "scalar";
+    }
+}
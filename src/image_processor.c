@@ -1,53 +1,145 @@
 #include "image_processor.h"
 #include "config.h"
 #include "logger.h"
+#include "thread_pool.h"
+#include "image_kernels.h"
+#include "jpeg_encoder.h"
+#include "png_encoder.h"
+#include "jpeg_decoder.h"
+#include "buffer_pool.h"
 #include <string.h>
 #include <stdlib.h>
 #include <math.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Mínimo de filas por banda para que valga la pena repartir el trabajo
+#define MIN_BAND_ROWS 64
+// Capacidad inicial del buffer de codificación
+#define ENCODE_BUFFER_INITIAL (256 * 1024)
+// Capacidad máxima que un hilo conserva entre imágenes; por encima se libera
+#define ENCODE_BUFFER_RETAIN_MAX (32 * 1024 * 1024)
+
+// Contexto compartido por las bandas de histograma y ecualización
+typedef struct
+{
+    unsigned char *image_data;
+    int width;
+    int height;
+    int channels;
+    int band_count;
+    int (*band_histograms)[256]; // Un histograma privado por banda
+    long long (*band_sums)[3];   // Sumas privadas de R,G,B por banda (NULL si no se piden)
+    const unsigned char *lookup_table;
+} band_context_t;
+
+// Número de bandas de filas según el tamaño de la imagen y el pool de cómputo
+static int compute_band_count(int height)
+{
+    int bands = thread_pool_concurrency() * 2; // Dos bandas por hilo para equilibrar carga
+    int max_bands = height / MIN_BAND_ROWS;
+
+    if (bands > max_bands)
+        bands = max_bands;
+    if (bands < 1)
+        bands = 1;
+    return bands;
+}
 
-// Función para calcular histograma de una imagen
-void calculate_histogram(const unsigned char *image_data, int width, int height, int channels, int histogram[256])
+// Filas [first_row, last_row) de una banda
+static void band_rows(const band_context_t *ctx, int band, int *first_row, int *last_row)
+{
+    *first_row = (int)((long long)ctx->height * band / ctx->band_count);
+    *last_row = (int)((long long)ctx->height * (band + 1) / ctx->band_count);
+}
+
+// Tarea: histograma (y sumas de canales) privados de una banda; las filas
+// son contiguas en memoria
+static void analyze_band_task(void *arg, int band)
+{
+    band_context_t *ctx = (band_context_t *)arg;
+    int *histogram = ctx->band_histograms[band];
+    long long *sums = ctx->band_sums ? ctx->band_sums[band] : NULL;
+    int first_row, last_row;
+    size_t stride = (size_t)ctx->width * ctx->channels;
+
+    memset(histogram, 0, 256 * sizeof(int));
+    if (sums)
+        memset(sums, 0, 3 * sizeof(long long));
+    band_rows(ctx, band, &first_row, &last_row);
+
+    kernel_analyze_pixels(ctx->image_data + (size_t)first_row * stride,
+                          (size_t)(last_row - first_row) * ctx->width, ctx->channels, histogram, sums);
+}
+
+// Función para analizar una imagen en una sola pasada: histograma de luminancia
+// y, si se pide, sumas de R,G,B para la clasificación por color
+void analyze_image(const unsigned char *image_data, int width, int height, int channels,
+                   int histogram[256], long long channel_sums[3])
 {
     // Inicializar histograma
     for (int i = 0; i < 256; i++)
     {
         histogram[i] = 0;
     }
+    if (channel_sums)
+    {
+        channel_sums[0] = channel_sums[1] = channel_sums[2] = 0;
+    }
 
     // Calcular histograma basado en luminancia para imágenes a color
-    // o usar el canal único para imágenes en escala de grises
-    for (int y = 0; y < height; y++)
+    // o usar el canal único para imágenes en escala de grises.
+    // La imagen se divide en bandas de filas con resultados privados que
+    // se calculan en paralelo y se suman al final.
+    band_context_t ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.image_data = (unsigned char *)image_data;
+    ctx.width = width;
+    ctx.height = height;
+    ctx.channels = channels;
+    ctx.band_count = compute_band_count(height);
+    ctx.band_histograms = malloc(sizeof(*ctx.band_histograms) * ctx.band_count);
+    if (channel_sums)
+        ctx.band_sums = malloc(sizeof(*ctx.band_sums) * ctx.band_count);
+
+    if (!ctx.band_histograms || (channel_sums && !ctx.band_sums))
     {
-        for (int x = 0; x < width; x++)
-        {
-            int pixel_index = (y * width + x) * channels;
-            int luminance;
+        // Sin memoria para las bandas: recorrer la imagen en este hilo
+        kernel_analyze_pixels(image_data, (size_t)width * height, channels, histogram, channel_sums);
+    }
+    else
+    {
+        parallel_for(ctx.band_count, analyze_band_task, &ctx);
 
-            if (channels >= 3)
+        for (int band = 0; band < ctx.band_count; band++)
+        {
+            for (int i = 0; i < 256; i++)
             {
-                // RGB: calcular luminancia usando fórmula estándar
-                int r = image_data[pixel_index];
-                int g = image_data[pixel_index + 1];
-                int b = image_data[pixel_index + 2];
-                luminance = (int)(0.299 * r + 0.587 * g + 0.114 * b);
+                histogram[i] += ctx.band_histograms[band][i];
             }
-            else
+            if (channel_sums)
             {
-                // Escala de grises
-                luminance = image_data[pixel_index];
+                channel_sums[0] += ctx.band_sums[band][0];
+                channel_sums[1] += ctx.band_sums[band][1];
+                channel_sums[2] += ctx.band_sums[band][2];
             }
-
-            // Asegurar que luminancia esté en rango válido
-            if (luminance < 0)
-                luminance = 0;
-            if (luminance > 255)
-                luminance = 255;
-
-            histogram[luminance]++;
         }
     }
+    free(ctx.band_histograms);
+    free(ctx.band_sums);
 
+    LOG_DEBUG("Imagen analizada: %dx%d con %d canales (%d bandas)",
+              width, height, channels, ctx.band_count);
+}
+
+// Función para calcular histograma de una imagen
+void calculate_histogram(const unsigned char *image_data, int width, int height, int channels, int histogram[256])
+{
+    analyze_image(image_data, width, height, channels, histogram, NULL);
     LOG_DEBUG("Histograma calculado para imagen %dx%d con %d canales", width, height, channels);
 }
 
@@ -64,18 +156,40 @@ void calculate_cumulative_histogram(const int histogram[256], int cumulative[256
     LOG_DEBUG("Frecuencias acumuladas calculadas");
 }
 
+// Tarea: aplicar la tabla de ecualización a una banda de filas
+// (R,G,B o gris; el canal alpha, si existe, permanece igual)
+static void equalize_band_task(void *arg, int band)
+{
+    band_context_t *ctx = (band_context_t *)arg;
+    int first_row, last_row;
+    size_t stride = (size_t)ctx->width * ctx->channels;
+
+    band_rows(ctx, band, &first_row, &last_row);
+
+    kernel_apply_lut(ctx->image_data + (size_t)first_row * stride,
+                     (size_t)(last_row - first_row) * ctx->width, ctx->channels, ctx->lookup_table);
+}
+
 // Función para ecualizar histograma
 int equalize_histogram(unsigned char *image_data, int width, int height, int channels)
 {
-    LOG_INFO("Iniciando ecualización de histograma para imagen %dx%d", width, height);
-
     int histogram[256];
-    int cumulative[256];
-    int total_pixels = width * height;
 
     // Calcular histograma original
     calculate_histogram(image_data, width, height, channels, histogram);
 
+    return equalize_with_histogram(image_data, width, height, channels, histogram);
+}
+
+// Función para ecualizar a partir de un histograma ya calculado
+int equalize_with_histogram(unsigned char *image_data, int width, int height, int channels,
+                            const int histogram[256])
+{
+    LOG_INFO("Iniciando ecualización de histograma para imagen %dx%d", width, height);
+
+    int cumulative[256];
+    long long total_pixels = (long long)width * height;
+
     // Calcular frecuencias acumuladas
     calculate_cumulative_histogram(histogram, cumulative);
 
@@ -84,36 +198,21 @@ int equalize_histogram(unsigned char *image_data, int width, int height, int cha
     for (int i = 0; i < 256; i++)
     {
         // Aplicar la fórmula: nuevo_pixel = (frecuencia_acumulada * 255) / total_pixels
-        lookup_table[i] = (unsigned char)((cumulative[i] * 255) / total_pixels);
+        // (en 64 bits: con más de ~8.4 millones de pixeles el producto desborda int)
+        lookup_table[i] = (unsigned char)(((long long)cumulative[i] * 255) / total_pixels);
     }
 
-    // Aplicar la ecualización a cada pixel
-    for (int y = 0; y < height; y++)
-    {
-        for (int x = 0; x < width; x++)
-        {
-            int pixel_index = (y * width + x) * channels;
+    // Aplicar la ecualización a cada pixel, por bandas de filas en paralelo
+    band_context_t ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.image_data = image_data;
+    ctx.width = width;
+    ctx.height = height;
+    ctx.channels = channels;
+    ctx.band_count = compute_band_count(height);
+    ctx.lookup_table = lookup_table;
 
-            if (channels >= 3)
-            {
-                // Para imágenes RGB, ecualizar cada canal por separado
-                image_data[pixel_index] = lookup_table[image_data[pixel_index]];         // R
-                image_data[pixel_index + 1] = lookup_table[image_data[pixel_index + 1]]; // G
-                image_data[pixel_index + 2] = lookup_table[image_data[pixel_index + 2]]; // B
-
-                // Si hay canal alpha, mantenerlo sin cambios
-                if (channels == 4)
-                {
-                    // Alpha channel permanece igual
-                }
-            }
-            else
-            {
-                // Para escala de grises
-                image_data[pixel_index] = lookup_table[image_data[pixel_index]];
-            }
-        }
-    }
+    parallel_for(ctx.band_count, equalize_band_task, &ctx);
 
     LOG_INFO("Ecualización de histograma completada exitosamente");
     return 1;
@@ -128,27 +227,30 @@ color_category_t get_predominant_color(const unsigned char *image_data, int widt
         return COLOR_UNDEFINED;
     }
 
-    long long red_sum = 0, green_sum = 0, blue_sum = 0;
-    int total_pixels = width * height;
+    int histogram[256];
+    long long channel_sums[3];
 
     LOG_DEBUG("Analizando color predominante en imagen %dx%d", width, height);
 
     // Sumar valores de cada canal
-    for (int y = 0; y < height; y++)
+    analyze_image(image_data, width, height, channels, histogram, channel_sums);
+
+    return classify_channel_sums(channel_sums, (long long)width * height, channels);
+}
+
+// Función para clasificar por color a partir de las sumas de canales
+color_category_t classify_channel_sums(const long long channel_sums[3], long long total_pixels, int channels)
+{
+    if (channels < 3 || total_pixels <= 0)
     {
-        for (int x = 0; x < width; x++)
-        {
-            int pixel_index = (y * width + x) * channels;
-            red_sum += image_data[pixel_index];
-            green_sum += image_data[pixel_index + 1];
-            blue_sum += image_data[pixel_index + 2];
-        }
+        LOG_DEBUG("Imagen en escala de grises, clasificando como indefinida");
+        return COLOR_UNDEFINED;
     }
 
     // Calcular promedios
-    int red_avg = (int)(red_sum / total_pixels);
-    int green_avg = (int)(green_sum / total_pixels);
-    int blue_avg = (int)(blue_sum / total_pixels);
+    int red_avg = (int)(channel_sums[0] / total_pixels);
+    int green_avg = (int)(channel_sums[1] / total_pixels);
+    int blue_avg = (int)(channel_sums[2] / total_pixels);
 
     LOG_DEBUG("Promedios de color: R=%d, G=%d, B=%d", red_avg, green_avg, blue_avg);
 
@@ -214,14 +316,240 @@ const char *get_color_directory(color_category_t color)
     }
 }
 
-// Función para procesar imagen completa
-int process_image_complete(const char *input_filepath, const char *original_filename, processed_image_info_t *result)
+// Buffer en memoria donde se codifica la imagen de salida. Cada hilo
+// trabajador conserva el suyo entre imágenes para no volver a crecerlo
+typedef struct
 {
-    LOG_INFO("Iniciando procesamiento completo de imagen: %s", input_filepath);
+    unsigned char *data;
+    size_t size;
+    size_t capacity;
+    int failed; // Falló una reserva durante la codificación
+} encoded_image_t;
+
+static pthread_key_t encode_buffer_key;
+static pthread_once_t encode_buffer_once = PTHREAD_ONCE_INIT;
+
+static void free_encode_buffer(void *buffer)
+{
+    encoded_image_t *encoded = (encoded_image_t *)buffer;
+    buffer_pool_free(encoded->data);
+    free(encoded);
+}
+
+static void create_encode_buffer_key(void)
+{
+    pthread_key_create(&encode_buffer_key, free_encode_buffer);
+}
+
+// Obtiene (o crea) el buffer de codificación del hilo actual, vacío
+static encoded_image_t *acquire_encode_buffer(void)
+{
+    pthread_once(&encode_buffer_once, create_encode_buffer_key);
+
+    encoded_image_t *encoded = pthread_getspecific(encode_buffer_key);
+    if (!encoded)
+    {
+        encoded = calloc(1, sizeof(encoded_image_t));
+        if (!encoded)
+            return NULL;
+        if (pthread_setspecific(encode_buffer_key, encoded) != 0)
+        {
+            free(encoded);
+            return NULL;
+        }
+    }
+
+    encoded->size = 0;
+    encoded->failed = 0;
+    return encoded;
+}
+
+// Devuelve el buffer al hilo; si creció demasiado (imagen muy grande) se libera
+static void release_encode_buffer(encoded_image_t *encoded)
+{
+    if (encoded->capacity > ENCODE_BUFFER_RETAIN_MAX)
+    {
+        buffer_pool_free(encoded->data);
+        encoded->data = NULL;
+        encoded->capacity = 0;
+    }
+    encoded->size = 0;
+}
 
-    // Inicializar estructura de resultado
+// Callback de stbi_write_*_to_func: agrega bytes al buffer
+static void append_encoded_bytes(void *context, void *data, int size)
+{
+    encoded_image_t *encoded = (encoded_image_t *)context;
+
+    if (encoded->failed || size <= 0)
+        return;
+
+    if (encoded->size + (size_t)size > encoded->capacity)
+    {
+        size_t new_capacity = encoded->capacity ? encoded->capacity * 2 : ENCODE_BUFFER_INITIAL;
+        while (new_capacity < encoded->size + (size_t)size)
+            new_capacity *= 2;
+
+        unsigned char *new_data = buffer_pool_realloc(encoded->data, new_capacity);
+        if (!new_data)
+        {
+            encoded->failed = 1;
+            return;
+        }
+        encoded->data = new_data;
+        encoded->capacity = new_capacity;
+    }
+
+    memcpy(encoded->data + encoded->size, data, (size_t)size);
+    encoded->size += (size_t)size;
+}
+
+// Codifica la imagen como PNG o JPG (calidad 90) en el buffer del hilo.
+// Devuelve NULL si falla; el buffer se devuelve con release_encode_buffer
+static encoded_image_t *encode_image(int as_png, int width, int height, int channels,
+                                     const unsigned char *image_data)
+{
+    encoded_image_t *encoded = acquire_encode_buffer();
+    int ok;
+
+    if (!encoded)
+        return NULL;
+
+    if (as_png)
+        ok = parallel_png_write_to_func(append_encoded_bytes, encoded, width, height, channels, image_data,
+                                        server_config.png_compression_level);
+    else
+        ok = parallel_jpeg_write_to_func(append_encoded_bytes, encoded, width, height, channels, image_data, 90);
+
+    if (!ok || encoded->failed || encoded->size == 0)
+    {
+        release_encode_buffer(encoded);
+        return NULL;
+    }
+    return encoded;
+}
+
+// Escribe los bytes codificados en path. Se elimina primero la entrada
+// existente para no modificar a través de un hardlink la copia de una
+// imagen anterior con el mismo nombre
+static int write_encoded_file(const char *path, const encoded_image_t *encoded)
+{
+    if (unlink(path) != 0 && errno != ENOENT)
+    {
+        LOG_WARNING("No se pudo reemplazar %s: %s", path, strerror(errno));
+    }
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        LOG_ERROR("Error abriendo %s: %s", path, strerror(errno));
+        return 0;
+    }
+
+    // El tamaño final es conocido: reservar los bloques de una vez. Si el
+    // sistema de archivos no soporta fallocate se escribe igual
+    if (fallocate(fd, 0, 0, (off_t)encoded->size) != 0 && errno == ENOSPC)
+    {
+        LOG_ERROR("Sin espacio para %s (%zu bytes)", path, encoded->size);
+        close(fd);
+        unlink(path);
+        return 0;
+    }
+
+    // Normalmente una sola llamada; el bucle cubre escrituras parciales
+    size_t written = 0;
+    while (written < encoded->size)
+    {
+        ssize_t n = write(fd, encoded->data + written, encoded->size - written);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            LOG_ERROR("Error escribiendo %s: %s", path, strerror(errno));
+            close(fd);
+            unlink(path);
+            return 0;
+        }
+        written += (size_t)n;
+    }
+
+    if (close(fd) != 0)
+    {
+        LOG_ERROR("Error cerrando %s: %s", path, strerror(errno));
+        unlink(path);
+        return 0;
+    }
+    return 1;
+}
+
+// Crea la copia clasificada como hardlink de la ecualizada; si el sistema de
+// archivos no lo permite (p.ej. directorios en distintos montajes) escribe
+// los mismos bytes ya codificados
+static int write_classified_copy(const char *equalized_path, const char *classified_path,
+                                 const encoded_image_t *encoded)
+{
+    if (unlink(classified_path) != 0 && errno != ENOENT)
+    {
+        LOG_WARNING("No se pudo reemplazar %s: %s", classified_path, strerror(errno));
+    }
+
+    if (link(equalized_path, classified_path) == 0)
+    {
+        LOG_DEBUG("Copia clasificada enlazada: %s -> %s", classified_path, equalized_path);
+        return 1;
+    }
+
+    LOG_DEBUG("Hardlink no disponible para %s (%s), escribiendo copia", classified_path, strerror(errno));
+    return write_encoded_file(classified_path, encoded);
+}
+
+// Mapea el archivo completo y lo decodifica desde la mapping: sin copias
+// intermedias ni lecturas por bloques, y MADV_SEQUENTIAL deja al kernel leer
+// por adelantado. Los JPEG con reinicios se decodifican en franjas paralelas,
+// el resto con stb
+static unsigned char *load_image_fd(int fd, const char *label, int *width, int *height, int *channels)
+{
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0)
+    {
+        LOG_ERROR("Archivo vacío o inaccesible: %s", label);
+        return NULL;
+    }
+
+    size_t size = (size_t)st.st_size;
+    void *mapped = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapped == MAP_FAILED)
+    {
+        LOG_ERROR("Error mapeando %s: %s", label, strerror(errno));
+        return NULL;
+    }
+    madvise(mapped, size, MADV_SEQUENTIAL);
+
+    unsigned char *pixels = parallel_jpeg_load_from_memory(mapped, size, width, height, channels, 0);
+
+    munmap(mapped, size);
+    return pixels;
+}
+
+static unsigned char *load_image(const char *filepath, int *width, int *height, int *channels)
+{
+    int fd = open(filepath, O_RDONLY);
+    if (fd < 0)
+    {
+        LOG_ERROR("Error abriendo %s: %s", filepath, strerror(errno));
+        return NULL;
+    }
+
+    unsigned char *pixels = load_image_fd(fd, filepath, width, height, channels);
+    close(fd);
+    return pixels;
+}
+
+// Inicializar el resultado con la ruta de origen y el nombre original
+static void init_result(processed_image_info_t *result, const char *source, const char *original_filename)
+{
     memset(result, 0, sizeof(processed_image_info_t));
-    strncpy(result->original_path, input_filepath, sizeof(result->original_path) - 1);
+    strncpy(result->original_path, source, sizeof(result->original_path) - 1);
 
     // Guardar el nombre original en la estructura result
     if (original_filename && strlen(original_filename) > 0)
@@ -229,24 +557,26 @@ int process_image_complete(const char *input_filepath, const char *original_file
         strncpy(result->original_filename, original_filename, sizeof(result->original_filename) - 1);
         result->original_filename[sizeof(result->original_filename) - 1] = '\0';
     }
+}
 
-    // Cargar imagen
-    int width, height, channels;
-    unsigned char *image_data = stbi_load(input_filepath, &width, &height, &channels, 0);
-    if (!image_data)
-    {
-        LOG_ERROR("Error cargando imagen: %s (%s)", input_filepath, stbi_failure_reason());
-        return -1;
-    }
-
+// Ecualizar, clasificar y guardar una imagen ya decodificada (libera image_data)
+static int process_loaded_image(unsigned char *image_data, int width, int height, int channels,
+                                const char *input_filepath, const char *original_filename,
+                                processed_image_info_t *result)
+{
     LOG_INFO("Imagen cargada: %dx%d, %d canales", width, height, channels);
 
-    // 1. Determinar color predominante ANTES de ecualizar
-    color_category_t predominant_color = get_predominant_color(image_data, width, height, channels);
+    // 1. Una sola pasada de análisis: sumas de canales (color predominante,
+    // ANTES de ecualizar) e histograma de luminancia
+    int histogram[256];
+    long long channel_sums[3];
+    analyze_image(image_data, width, height, channels, histogram, channel_sums);
+
+    color_category_t predominant_color = classify_channel_sums(channel_sums, (long long)width * height, channels);
     result->predominant_color = predominant_color;
 
-    // 2. Aplicar ecualización de histograma
-    if (!equalize_histogram(image_data, width, height, channels))
+    // 2. Aplicar ecualización de histograma (la pasada de remapeo es la única otra lectura)
+    if (!equalize_with_histogram(image_data, width, height, channels, histogram))
     {
         LOG_ERROR("Error aplicando ecualización de histograma");
         stbi_image_free(image_data);
@@ -277,29 +607,29 @@ int process_image_complete(const char *input_filepath, const char *original_file
     generate_processed_filename(filename_to_use, "equalized", equalized_filename, sizeof(equalized_filename));
     snprintf(result->equalized_path, sizeof(result->equalized_path), "%s/%s", server_config.processed_path, equalized_filename);
 
-    // 4. Guardar imagen ecualizada
-    int save_result = 0;
+    // 4. Codificar una sola vez en memoria y guardar imagen ecualizada
     const char *ext = strrchr(filename_to_use, '.');
-    if (ext && (strcmp(ext, ".png") == 0 || strcmp(ext, ".PNG") == 0))
-    {
-        save_result = stbi_write_png(result->equalized_path, width, height, channels, image_data, width * channels);
-    }
-    else
+    int as_png = ext && (strcmp(ext, ".png") == 0 || strcmp(ext, ".PNG") == 0); // Por defecto JPG
+    encoded_image_t *encoded = encode_image(as_png, width, height, channels, image_data);
+
+    if (!encoded)
     {
-        // Por defecto guardar como JPG
-        save_result = stbi_write_jpg(result->equalized_path, width, height, channels, image_data, 90);
+        LOG_ERROR("Error codificando imagen ecualizada: %s", result->equalized_path);
+        stbi_image_free(image_data);
+        return -1;
     }
 
-    if (!save_result)
+    if (!write_encoded_file(result->equalized_path, encoded))
     {
         LOG_ERROR("Error guardando imagen ecualizada: %s", result->equalized_path);
+        release_encode_buffer(encoded);
         stbi_image_free(image_data);
         return -1;
     }
 
-    LOG_INFO("Imagen ecualizada guardada: %s", result->equalized_path);
+    LOG_INFO("Imagen ecualizada guardada: %s (%zu bytes)", result->equalized_path, encoded->size);
 
-    // 5. Si tiene color predominante, guardar copia clasificada
+    // 5. Si tiene color predominante, guardar copia clasificada (mismos bytes)
     if (predominant_color != COLOR_UNDEFINED)
     {
         const char *color_dir = get_color_directory(predominant_color);
@@ -309,17 +639,7 @@ int process_image_complete(const char *input_filepath, const char *original_file
         generate_processed_filename(filename_to_use, color_names[predominant_color], classified_filename, sizeof(classified_filename));
         snprintf(result->classified_path, sizeof(result->classified_path), "%s/%s", color_dir, classified_filename);
 
-        // Guardar copia en directorio de color
-        if (ext && (strcmp(ext, ".png") == 0 || strcmp(ext, ".PNG") == 0))
-        {
-            save_result = stbi_write_png(result->classified_path, width, height, channels, image_data, width * channels);
-        }
-        else
-        {
-            save_result = stbi_write_jpg(result->classified_path, width, height, channels, image_data, 90);
-        }
-
-        if (save_result)
+        if (write_classified_copy(result->equalized_path, result->classified_path, encoded))
         {
             LOG_INFO("Imagen clasificada guardada: %s", result->classified_path);
         }
@@ -329,6 +649,8 @@ int process_image_complete(const char *input_filepath, const char *original_file
         }
     }
 
+    release_encode_buffer(encoded);
+
     // 6. Limpiar memoria
     stbi_image_free(image_data);
 
@@ -342,6 +664,64 @@ int process_image_complete(const char *input_filepath, const char *original_file
     return 0;
 }
 
+// Función para procesar imagen completa
+int process_image_complete(const char *input_filepath, const char *original_filename, processed_image_info_t *result)
+{
+    LOG_INFO("Iniciando procesamiento completo de imagen: %s", input_filepath);
+    init_result(result, input_filepath, original_filename);
+
+    // Cargar imagen
+    int width, height, channels;
+    unsigned char *image_data = load_image(input_filepath, &width, &height, &channels);
+    if (!image_data)
+    {
+        LOG_ERROR("Error cargando imagen: %s (%s)", input_filepath, stbi_failure_reason());
+        return -1;
+    }
+
+    return process_loaded_image(image_data, width, height, channels, input_filepath, original_filename, result);
+}
+
+// Procesar un upload volcado a un spool anónimo (O_TMPFILE o memfd)
+int process_image_from_fd(int fd, const char *original_filename, processed_image_info_t *result)
+{
+    const char *source = (original_filename && original_filename[0]) ? original_filename : "upload";
+
+    LOG_INFO("Iniciando procesamiento de imagen desde spool anónimo: %s (fd %d)", source, fd);
+    init_result(result, source, original_filename);
+
+    int width, height, channels;
+    unsigned char *image_data = load_image_fd(fd, source, &width, &height, &channels);
+    if (!image_data)
+    {
+        LOG_ERROR("Error cargando imagen: %s (%s)", source, stbi_failure_reason());
+        return -1;
+    }
+
+    return process_loaded_image(image_data, width, height, channels, source, original_filename, result);
+}
+
+// Procesar un upload que llegó a la cola sin pasar por disco
+int process_image_from_memory(const unsigned char *data, size_t size, const char *original_filename,
+                              processed_image_info_t *result)
+{
+    // Sin archivo de origen: los logs y el nombre de respaldo usan el original
+    const char *source = (original_filename && original_filename[0]) ? original_filename : "upload";
+
+    LOG_INFO("Iniciando procesamiento en memoria de imagen: %s (%zu bytes)", source, size);
+    init_result(result, source, original_filename);
+
+    int width, height, channels;
+    unsigned char *image_data = parallel_jpeg_load_from_memory(data, size, &width, &height, &channels, 0);
+    if (!image_data)
+    {
+        LOG_ERROR("Error decodificando imagen: %s (%s)", source, stbi_failure_reason());
+        return -1;
+    }
+
+    return process_loaded_image(image_data, width, height, channels, source, original_filename, result);
+}
+
 // Función para limpiar imagen temporal después del procesamiento
 int cleanup_temp_image(const char *temp_filepath)
 {
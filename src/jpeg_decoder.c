@@ -0,0 +1,400 @@
+#include "jpeg_decoder.h"
+#include "thread_pool.h"
+#include "logger.h"
+#include "buffer_pool.h"
+#include "stb/stb_image.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Mínimo de filas de MCU por franja para que valga la pena repartir
+#define MIN_STRIP_MCU_ROWS 4
+// Con sobreposición cada franja abarca al menos estos segmentos entre
+// reinicios alineados, para que decodificar los vecinos cueste poco
+#define MIN_OVERLAP_SEGMENTS 4
+
+// Estructura de un JPEG baseline con reinicios, obtenida de sus marcadores
+typedef struct
+{
+    const unsigned char *data;
+    size_t sof_offset;  // Segmento SOF0/SOF1
+    size_t scan_offset; // Primer byte de datos entrópicos (fin de la cabecera)
+    int width;
+    int height;
+    int components;
+    int restart_interval;
+    int mcu_width;
+    int mcu_height;
+    int mcu_cols;
+    int mcu_rows;
+    int needs_overlap; // Croma submuestreado en vertical (stb interpola con la fila vecina)
+} jpeg_layout_t;
+
+// Reinicios que caen al inicio de una fila de MCU: desde ahí se puede
+// decodificar una franja como imagen independiente
+typedef struct
+{
+    int *rows;       // Fila de MCU donde empieza el segmento
+    size_t *offsets; // Primer byte entrópico del segmento (el último: EOI + 2)
+    int count;
+} restart_boundaries_t;
+
+// Contexto compartido por las tareas de decodificación de franjas
+typedef struct
+{
+    const jpeg_layout_t *layout;
+    const restart_boundaries_t *boundaries;
+    const int *strip_bounds; // Índices de límite: franja s = [strip_bounds[s], strip_bounds[s + 1])
+    int req_channels;
+    int out_channels;
+    unsigned char *pixels;
+    int *failed;
+} decode_job_t;
+
+static int read_be16(const unsigned char *p)
+{
+    return (p[0] << 8) | p[1];
+}
+
+// Recorre los marcadores hasta SOS. Solo acepta JPEG baseline (SOF0/SOF1 de
+// 8 bits) con DRI y un único scan con todas las componentes
+static int parse_jpeg_layout(const unsigned char *data, size_t size, jpeg_layout_t *layout)
+{
+    size_t pos = 2;
+    int h_max = 1, v_max = 1, v_min = 4;
+    int found_sof = 0;
+
+    memset(layout, 0, sizeof(*layout));
+    layout->data = data;
+
+    if (size < 4 || data[0] != 0xFF || data[1] != 0xD8)
+        return 0;
+
+    while (pos + 4 <= size)
+    {
+        if (data[pos] != 0xFF)
+            return 0;
+
+        unsigned char marker = data[pos + 1];
+        if (marker == 0xFF)
+        {
+            pos++; // Byte de relleno antes del marcador
+            continue;
+        }
+
+        size_t length = (size_t)read_be16(data + pos + 2);
+        if (length < 2 || pos + 2 + length > size)
+            return 0;
+
+        const unsigned char *segment = data + pos + 4;
+        switch (marker)
+        {
+        case 0xC0:
+        case 0xC1:
+            if (length < 8 || segment[0] != 8)
+                return 0;
+            layout->sof_offset = pos;
+            layout->height = read_be16(segment + 1);
+            layout->width = read_be16(segment + 3);
+            layout->components = segment[5];
+            if (layout->components < 1 || layout->components > 4 || length < 8 + 3 * (size_t)layout->components)
+                return 0;
+            for (int i = 0; i < layout->components; i++)
+            {
+                int h = segment[6 + i * 3 + 1] >> 4;
+                int v = segment[6 + i * 3 + 1] & 15;
+                if (h > h_max)
+                    h_max = h;
+                if (v > v_max)
+                    v_max = v;
+                if (v < v_min)
+                    v_min = v;
+            }
+            found_sof = 1;
+            break;
+        case 0xC2: // Progresivo
+        case 0xC3: // Sin pérdida
+        case 0xC5:
+        case 0xC6:
+        case 0xC7:
+        case 0xC9: // Codificación aritmética
+        case 0xCA:
+        case 0xCB:
+        case 0xCD:
+        case 0xCE:
+        case 0xCF:
+            return 0;
+        case 0xDD:
+            if (length < 4)
+                return 0;
+            layout->restart_interval = read_be16(segment);
+            break;
+        case 0xDA:
+            if (!found_sof || segment[0] != layout->components)
+                return 0;
+            layout->scan_offset = pos + 2 + length;
+            break;
+        default:
+            break;
+        }
+
+        if (layout->scan_offset)
+            break;
+        pos += 2 + length;
+    }
+
+    if (!layout->scan_offset || layout->restart_interval <= 0 || layout->width <= 0 || layout->height <= 0)
+        return 0;
+
+    // Un scan de una sola componente no se intercala: cada MCU es un bloque 8x8
+    layout->mcu_width = layout->components == 1 ? 8 : 8 * h_max;
+    layout->mcu_height = layout->components == 1 ? 8 : 8 * v_max;
+    layout->mcu_cols = (layout->width + layout->mcu_width - 1) / layout->mcu_width;
+    layout->mcu_rows = (layout->height + layout->mcu_height - 1) / layout->mcu_height;
+    layout->needs_overlap = layout->components > 1 && v_min < v_max;
+    return 1;
+}
+
+// Recorre los datos entrópicos buscando RSTn y guarda los que empiezan fila.
+// Falla si el número de reinicios no corresponde al DRI o el scan no termina en EOI
+static int find_restart_boundaries(const unsigned char *data, size_t size, const jpeg_layout_t *layout,
+                                   restart_boundaries_t *boundaries)
+{
+    long long total_mcus = (long long)layout->mcu_cols * layout->mcu_rows;
+    long long intervals = (total_mcus + layout->restart_interval - 1) / layout->restart_interval;
+    const unsigned char *p = data + layout->scan_offset;
+    const unsigned char *end = data + size;
+    long long restarts = 0;
+
+    boundaries->rows = malloc(sizeof(int) * (size_t)(layout->mcu_rows + 1));
+    boundaries->offsets = malloc(sizeof(size_t) * (size_t)(layout->mcu_rows + 1));
+    boundaries->count = 0;
+    if (!boundaries->rows || !boundaries->offsets)
+        return 0;
+
+    boundaries->rows[0] = 0;
+    boundaries->offsets[0] = layout->scan_offset;
+    boundaries->count = 1;
+
+    while (p < end)
+    {
+        const unsigned char *marker = memchr(p, 0xFF, (size_t)(end - p));
+        if (!marker || marker + 1 >= end)
+            return 0;
+
+        unsigned char code = marker[1];
+        if (code == 0x00)
+        {
+            p = marker + 2; // 0xFF literal dentro de los datos
+            continue;
+        }
+        if (code == 0xFF)
+        {
+            p = marker + 1;
+            continue;
+        }
+        if (code >= 0xD0 && code <= 0xD7)
+        {
+            long long first_mcu = ++restarts * layout->restart_interval;
+            if (first_mcu % layout->mcu_cols == 0 && first_mcu < total_mcus)
+            {
+                boundaries->rows[boundaries->count] = (int)(first_mcu / layout->mcu_cols);
+                boundaries->offsets[boundaries->count] = (size_t)(marker + 2 - data);
+                boundaries->count++;
+            }
+            p = marker + 2;
+            continue;
+        }
+
+        // Otro marcador: debe ser el EOI que cierra el único scan
+        if (code != 0xD9 || restarts != intervals - 1)
+            return 0;
+
+        // Límite final: el segmento anterior termina 2 bytes antes, igual que ante un RSTn
+        boundaries->rows[boundaries->count] = layout->mcu_rows;
+        boundaries->offsets[boundaries->count] = (size_t)(marker + 2 - data);
+        boundaries->count++;
+        return 1;
+    }
+    return 0;
+}
+
+// Decodifica una franja como JPEG independiente: la cabecera original con el
+// alto ajustado (conserva DRI y tablas) más los segmentos entrópicos y un EOI
+static void decode_strip_task(void *ctx, int index)
+{
+    decode_job_t *job = (decode_job_t *)ctx;
+    const jpeg_layout_t *layout = job->layout;
+    const restart_boundaries_t *boundaries = job->boundaries;
+    int first = job->strip_bounds[index];
+    int last = job->strip_bounds[index + 1];
+
+    // Con croma submuestreado en vertical se decodifica además un segmento
+    // vecino a cada lado para que las filas del borde se interpolen igual
+    int decode_first = first;
+    int decode_last = last;
+    if (layout->needs_overlap)
+    {
+        if (decode_first > 0)
+            decode_first--;
+        if (decode_last < boundaries->count - 1)
+            decode_last++;
+    }
+
+    int decode_top = boundaries->rows[decode_first] * layout->mcu_height;
+    int decode_bottom = boundaries->rows[decode_last] * layout->mcu_height;
+    if (decode_bottom > layout->height)
+        decode_bottom = layout->height;
+    int strip_height = decode_bottom - decode_top;
+
+    size_t entropy_start = boundaries->offsets[decode_first];
+    size_t entropy_end = boundaries->offsets[decode_last] - 2;
+    size_t header_size = layout->scan_offset;
+    size_t jpeg_size = header_size + (entropy_end - entropy_start) + 2;
+
+    unsigned char *jpeg = buffer_pool_alloc(jpeg_size);
+    if (!jpeg)
+    {
+        __atomic_store_n(job->failed, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    memcpy(jpeg, layout->data, header_size);
+    jpeg[layout->sof_offset + 5] = (unsigned char)(strip_height >> 8);
+    jpeg[layout->sof_offset + 6] = (unsigned char)(strip_height & 0xFF);
+    memcpy(jpeg + header_size, layout->data + entropy_start, entropy_end - entropy_start);
+    jpeg[jpeg_size - 2] = 0xFF;
+    jpeg[jpeg_size - 1] = 0xD9;
+
+    int w, h, n;
+    unsigned char *strip = stbi_load_from_memory(jpeg, (int)jpeg_size, &w, &h, &n, job->req_channels);
+    buffer_pool_free(jpeg);
+
+    if (!strip || w != layout->width || h != strip_height)
+    {
+        stbi_image_free(strip);
+        __atomic_store_n(job->failed, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    // Copiar solo las filas propias de la franja
+    int top = boundaries->rows[first] * layout->mcu_height;
+    int bottom = boundaries->rows[last] * layout->mcu_height;
+    if (bottom > layout->height)
+        bottom = layout->height;
+
+    size_t row_bytes = (size_t)layout->width * job->out_channels;
+    memcpy(job->pixels + (size_t)top * row_bytes, strip + (size_t)(top - decode_top) * row_bytes,
+           (size_t)(bottom - top) * row_bytes);
+    stbi_image_free(strip);
+}
+
+// Elige los límites de las franjas entre los reinicios alineados a fila,
+// lo más parejos posible. Devuelve el número de franjas
+static int choose_strips(const jpeg_layout_t *layout, const restart_boundaries_t *boundaries, int *strip_bounds)
+{
+    // Sin paralelismo real las franjas (y sus filas de sobreposición) son trabajo extra
+    int concurrency = thread_pool_concurrency();
+    if (concurrency <= 1)
+        return 1;
+
+    int segments = boundaries->count - 1;
+    int strip_count = concurrency * 2; // Dos franjas por hilo para equilibrar carga
+
+    if (strip_count > layout->mcu_rows / MIN_STRIP_MCU_ROWS)
+        strip_count = layout->mcu_rows / MIN_STRIP_MCU_ROWS;
+    if (layout->needs_overlap && strip_count > segments / MIN_OVERLAP_SEGMENTS)
+        strip_count = segments / MIN_OVERLAP_SEGMENTS;
+    if (strip_count > segments)
+        strip_count = segments;
+    if (strip_count <= 1)
+        return strip_count;
+
+    int chosen = 0;
+    int b = 0;
+    strip_bounds[chosen++] = 0;
+    for (int s = 1; s < strip_count; s++)
+    {
+        int target_row = (int)((long long)s * layout->mcu_rows / strip_count);
+        while (b < segments && boundaries->rows[b] < target_row)
+            b++;
+        if (b > strip_bounds[chosen - 1] && b < segments)
+            strip_bounds[chosen++] = b;
+    }
+    strip_bounds[chosen] = segments;
+    return chosen;
+}
+
+// Decodifica en franjas paralelas; NULL si el archivo no lo permite o falla
+static unsigned char *decode_in_strips(const unsigned char *data, size_t size, int *width, int *height,
+                                       int *channels, int req_channels)
+{
+    jpeg_layout_t layout;
+    restart_boundaries_t boundaries = {0};
+    int *strip_bounds = NULL;
+    unsigned char *pixels = NULL;
+    int strip_count = 0;
+
+    if (parse_jpeg_layout(data, size, &layout) && find_restart_boundaries(data, size, &layout, &boundaries))
+    {
+        strip_bounds = malloc(sizeof(int) * (size_t)boundaries.count);
+        if (strip_bounds)
+            strip_count = choose_strips(&layout, &boundaries, strip_bounds);
+    }
+
+    if (strip_count > 1)
+    {
+        // stb entrega 3 canales para JPEG de 3-4 componentes y 1 para gris
+        int file_channels = layout.components >= 3 ? 3 : 1;
+        int out_channels = req_channels ? req_channels : file_channels;
+        int failed = 0;
+
+        pixels = buffer_pool_alloc((size_t)layout.width * layout.height * out_channels);
+        if (pixels)
+        {
+            decode_job_t job = {
+                .layout = &layout,
+                .boundaries = &boundaries,
+                .strip_bounds = strip_bounds,
+                .req_channels = req_channels,
+                .out_channels = out_channels,
+                .pixels = pixels,
+                .failed = &failed,
+            };
+            parallel_for(strip_count, decode_strip_task, &job);
+
+            if (failed)
+            {
+                LOG_WARNING("JPEG paralelo: falló una franja, decodificando secuencialmente");
+                buffer_pool_free(pixels);
+                pixels = NULL;
+            }
+            else
+            {
+                LOG_DEBUG("JPEG paralelo: %dx%d decodificado en %d franjas (DRI %d%s)", layout.width,
+                          layout.height, strip_count, layout.restart_interval,
+                          layout.needs_overlap ? ", con sobreposición" : "");
+                *width = layout.width;
+                *height = layout.height;
+                *channels = file_channels;
+            }
+        }
+    }
+
+    free(strip_bounds);
+    free(boundaries.rows);
+    free(boundaries.offsets);
+    return pixels;
+}
+
+unsigned char *parallel_jpeg_load_from_memory(const unsigned char *data, size_t size, int *width, int *height,
+                                              int *channels, int req_channels)
+{
+    if (!data || size > 0x7FFFFFFF || req_channels < 0 || req_channels > 4)
+        return NULL;
+
+    unsigned char *pixels = decode_in_strips(data, size, width, height, channels, req_channels);
+    if (pixels)
+        return pixels;
+
+    return stbi_load_from_memory(data, (int)size, width, height, channels, req_channels);
+}
@@ -0,0 +1,237 @@
+#include "jpeg_encoder.h"
+#include "thread_pool.h"
+#include "logger.h"
+#include "buffer_pool.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Mínimo de filas de MCU por franja para que valga la pena repartir
+#define MIN_STRIP_MCU_ROWS 4
+// El intervalo de reinicio (DRI) es un entero de 16 bits en MCUs
+#define MAX_RESTART_INTERVAL 65535
+// Capacidad inicial del buffer de cada franja
+#define STRIP_BUFFER_INITIAL (64 * 1024)
+
+// Salida JPEG completa de una franja, codificada como imagen independiente
+typedef struct
+{
+    unsigned char *data;
+    size_t size;
+    size_t capacity;
+    int failed;
+} strip_output_t;
+
+// Contexto compartido por las tareas de codificación de franjas
+typedef struct
+{
+    const unsigned char *data;
+    int width;
+    int height;
+    int channels;
+    int quality;
+    int strip_rows; // Filas de pixeles por franja (múltiplo del alto de MCU)
+    strip_output_t *strips;
+} strip_job_t;
+
+static void append_strip_bytes(void *context, void *data, int size)
+{
+    strip_output_t *strip = (strip_output_t *)context;
+
+    if (strip->failed || size <= 0)
+        return;
+
+    if (strip->size + (size_t)size > strip->capacity)
+    {
+        size_t new_capacity = strip->capacity ? strip->capacity * 2 : STRIP_BUFFER_INITIAL;
+        while (new_capacity < strip->size + (size_t)size)
+            new_capacity *= 2;
+
+        unsigned char *new_data = buffer_pool_realloc(strip->data, new_capacity);
+        if (!new_data)
+        {
+            strip->failed = 1;
+            return;
+        }
+        strip->data = new_data;
+        strip->capacity = new_capacity;
+    }
+
+    memcpy(strip->data + strip->size, data, (size_t)size);
+    strip->size += (size_t)size;
+}
+
+// Codifica las filas de una franja como un JPEG independiente: sus predictores
+// DC arrancan en 0 y el último byte se rellena con unos, justo lo que exige un
+// intervalo de reinicio
+static void encode_strip_task(void *ctx, int index)
+{
+    strip_job_t *job = (strip_job_t *)ctx;
+    strip_output_t *strip = &job->strips[index];
+    int first_row = index * job->strip_rows;
+    int rows = job->height - first_row;
+
+    if (rows > job->strip_rows)
+        rows = job->strip_rows;
+
+    const unsigned char *strip_data = job->data + (size_t)first_row * job->width * job->channels;
+    if (!stbi_write_jpg_to_func(append_strip_bytes, strip, job->width, rows, job->channels, strip_data, job->quality))
+    {
+        strip->failed = 1;
+    }
+}
+
+// Ubica en la salida de stb el segmento SOF0 y el SOS; scan_offset es el
+// primer byte de datos entrópicos
+static int find_jpeg_segments(const unsigned char *jpeg, size_t size, size_t *sof_offset,
+                              size_t *sos_offset, size_t *scan_offset)
+{
+    size_t pos = 2; // Después de SOI
+    int found_sof = 0;
+
+    if (size < 4 || jpeg[0] != 0xFF || jpeg[1] != 0xD8)
+        return 0;
+
+    while (pos + 4 <= size && jpeg[pos] == 0xFF)
+    {
+        unsigned char marker = jpeg[pos + 1];
+        size_t length = ((size_t)jpeg[pos + 2] << 8) | jpeg[pos + 3];
+
+        if (marker == 0xC0)
+        {
+            *sof_offset = pos;
+            found_sof = 1;
+        }
+        else if (marker == 0xDA)
+        {
+            *sos_offset = pos;
+            *scan_offset = pos + 2 + length;
+            return found_sof && *scan_offset + 2 <= size;
+        }
+        pos += 2 + length;
+    }
+
+    return 0;
+}
+
+// Une las franjas: cabecera de la primera con el alto real y un DRI, los
+// datos entrópicos de cada franja separados por RST0..RST7 y el EOI final
+static int write_joined_strips(stbi_write_func *func, void *context, const strip_job_t *job,
+                               int strip_count, int restart_interval)
+{
+    const strip_output_t *first = &job->strips[0];
+    size_t sof_offset, sos_offset, scan_offset;
+
+    if (!find_jpeg_segments(first->data, first->size, &sof_offset, &sos_offset, &scan_offset))
+    {
+        LOG_ERROR("JPEG paralelo: salida de franja no reconocida");
+        return 0;
+    }
+
+    unsigned char *header = malloc(sos_offset);
+    if (!header)
+        return 0;
+
+    // SOF0: FF C0, longitud (2), precisión (1), alto (2), ancho (2)
+    memcpy(header, first->data, sos_offset);
+    header[sof_offset + 5] = (unsigned char)(job->height >> 8);
+    header[sof_offset + 6] = (unsigned char)(job->height & 0xFF);
+
+    unsigned char restart_segment[6] = {0xFF, 0xDD, 0x00, 0x04, (unsigned char)(restart_interval >> 8),
+                                        (unsigned char)(restart_interval & 0xFF)};
+
+    func(context, header, (int)sos_offset);
+    func(context, restart_segment, sizeof(restart_segment));
+    func(context, first->data + sos_offset, (int)(scan_offset - sos_offset));
+    free(header);
+
+    for (int i = 0; i < strip_count; i++)
+    {
+        const strip_output_t *strip = &job->strips[i];
+        size_t strip_scan = scan_offset;
+
+        // Todas las franjas comparten tablas; solo cambia el alto en SOF0
+        if (i > 0 && !find_jpeg_segments(strip->data, strip->size, &sof_offset, &sos_offset, &strip_scan))
+        {
+            LOG_ERROR("JPEG paralelo: salida de franja %d no reconocida", i);
+            return 0;
+        }
+
+        // Los datos entrópicos terminan justo antes del EOI (FF D9) de la franja
+        func(context, strip->data + strip_scan, (int)(strip->size - 2 - strip_scan));
+
+        if (i + 1 < strip_count)
+        {
+            unsigned char restart_marker[2] = {0xFF, (unsigned char)(0xD0 + (i & 7))};
+            func(context, restart_marker, sizeof(restart_marker));
+        }
+    }
+
+    unsigned char end_marker[2] = {0xFF, 0xD9};
+    func(context, end_marker, sizeof(end_marker));
+    return 1;
+}
+
+int parallel_jpeg_write_to_func(stbi_write_func *func, void *context, int width, int height, int channels,
+                                const unsigned char *data, int quality)
+{
+    if (!data || width <= 0 || height <= 0 || channels < 1 || channels > 4)
+        return 0;
+
+    // Sin paralelismo real las franjas solo agregan headers y reinicios
+    int concurrency = thread_pool_concurrency();
+    if (concurrency <= 1)
+        return stbi_write_jpg_to_func(func, context, width, height, channels, data, quality);
+
+    // stb usa submuestreo 4:2:0 (MCU de 16x16) con calidad <= 90, 4:4:4 (8x8) por encima
+    int mcu_size = quality <= 90 ? 16 : 8;
+    int mcu_cols = (width + mcu_size - 1) / mcu_size;
+    int mcu_rows = (height + mcu_size - 1) / mcu_size;
+
+    int strip_count = concurrency * 2; // Dos franjas por hilo para equilibrar carga
+    if (strip_count > mcu_rows / MIN_STRIP_MCU_ROWS)
+        strip_count = mcu_rows / MIN_STRIP_MCU_ROWS;
+
+    if (strip_count <= 1)
+        return stbi_write_jpg_to_func(func, context, width, height, channels, data, quality);
+
+    int strip_mcu_rows = (mcu_rows + strip_count - 1) / strip_count;
+    if (strip_mcu_rows * mcu_cols > MAX_RESTART_INTERVAL)
+        strip_mcu_rows = MAX_RESTART_INTERVAL / mcu_cols;
+    strip_count = (mcu_rows + strip_mcu_rows - 1) / strip_mcu_rows;
+
+    strip_job_t job = {
+        .data = data,
+        .width = width,
+        .height = height,
+        .channels = channels,
+        .quality = quality,
+        .strip_rows = strip_mcu_rows * mcu_size,
+        .strips = calloc((size_t)strip_count, sizeof(strip_output_t)),
+    };
+    if (!job.strips)
+        return 0;
+
+    parallel_for(strip_count, encode_strip_task, &job);
+
+    int ok = 1;
+    for (int i = 0; i < strip_count; i++)
+    {
+        if (job.strips[i].failed || job.strips[i].size == 0)
+        {
+            LOG_ERROR("JPEG paralelo: error codificando franja %d de %d", i, strip_count);
+            ok = 0;
+            break;
+        }
+    }
+
+    if (ok)
+    {
+        ok = write_joined_strips(func, context, &job, strip_count, strip_mcu_rows * mcu_cols);
+        LOG_DEBUG("JPEG paralelo: %dx%d en %d franjas de %d filas", width, height, strip_count, job.strip_rows);
+    }
+
+    for (int i = 0; i < strip_count; i++)
+        buffer_pool_free(job.strips[i].data);
+    free(job.strips);
+    return ok;
+}
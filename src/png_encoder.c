@@ -0,0 +1,371 @@
+#include "png_encoder.h"
+#include "thread_pool.h"
+#include "logger.h"
+#include "buffer_pool.h"
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+
+// Bytes filtrados mínimos por grupo: por debajo la pérdida de compresión y el
+// costo de iniciar deflate superan lo ganado al repartir (mismo bloque que pigz)
+#define MIN_GROUP_BYTES (128 * 1024)
+// Ventana de deflate: cada grupo se ceba con los últimos 32 KB del anterior
+#define DEFLATE_WINDOW 32768
+
+// Filtros de fila PNG
+#define PNG_FILTER_NONE 0
+#define PNG_FILTER_SUB 1
+#define PNG_FILTER_UP 2
+#define PNG_FILTER_AVERAGE 3
+#define PNG_FILTER_PAETH 4
+#define PNG_FILTER_COUNT 5
+
+// Salida deflate de un grupo de filas
+typedef struct
+{
+    unsigned char *data;
+    size_t size;
+    uLong adler;      // Adler-32 de los bytes filtrados del grupo
+    uLong crc;        // CRC-32 de la salida deflate (para el chunk IDAT)
+    size_t raw_bytes; // Bytes filtrados del grupo
+    int failed;
+} png_group_t;
+
+// Contexto compartido por las tareas de compresión
+typedef struct
+{
+    const unsigned char *pixels;
+    int width;
+    int height;
+    int channels;
+    int level;
+    int group_rows;
+    int group_count;
+    png_group_t *groups;
+} png_job_t;
+
+static unsigned char paeth_predictor(int a, int b, int c)
+{
+    int p = a + b - c;
+    int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+
+    if (pa <= pb && pa <= pc)
+        return (unsigned char)a;
+    if (pb <= pc)
+        return (unsigned char)b;
+    return (unsigned char)c;
+}
+
+// Aplica un filtro a una fila; prev es la fila anterior (ceros en la primera)
+static void filter_row(const unsigned char *row, const unsigned char *prev, int row_bytes, int bpp,
+                       int type, unsigned char *out)
+{
+    int i;
+
+    switch (type)
+    {
+    case PNG_FILTER_NONE:
+        memcpy(out, row, (size_t)row_bytes);
+        break;
+    case PNG_FILTER_SUB:
+        for (i = 0; i < bpp; i++)
+            out[i] = row[i];
+        for (; i < row_bytes; i++)
+            out[i] = (unsigned char)(row[i] - row[i - bpp]);
+        break;
+    case PNG_FILTER_UP:
+        for (i = 0; i < row_bytes; i++)
+            out[i] = (unsigned char)(row[i] - prev[i]);
+        break;
+    case PNG_FILTER_AVERAGE:
+        for (i = 0; i < bpp; i++)
+            out[i] = (unsigned char)(row[i] - (prev[i] >> 1));
+        for (; i < row_bytes; i++)
+            out[i] = (unsigned char)(row[i] - ((row[i - bpp] + prev[i]) >> 1));
+        break;
+    default:
+        for (i = 0; i < bpp; i++)
+            out[i] = (unsigned char)(row[i] - paeth_predictor(0, prev[i], 0));
+        for (; i < row_bytes; i++)
+            out[i] = (unsigned char)(row[i] - paeth_predictor(row[i - bpp], prev[i], prev[i - bpp]));
+        break;
+    }
+}
+
+// Filtra las filas [first_row, last_row) en out (un byte de tipo + la fila).
+// Igual que stb, elige por fila el filtro de menor suma de valores absolutos
+static int filter_rows(const png_job_t *job, int first_row, int last_row, unsigned char *out)
+{
+    int row_bytes = job->width * job->channels;
+    unsigned char *candidate = malloc((size_t)row_bytes * 2);
+    unsigned char *zero_row = calloc(1, (size_t)row_bytes);
+
+    if (!candidate || !zero_row)
+    {
+        free(candidate);
+        free(zero_row);
+        return 0;
+    }
+
+    for (int y = first_row; y < last_row; y++)
+    {
+        const unsigned char *row = job->pixels + (size_t)y * row_bytes;
+        const unsigned char *prev = y > 0 ? row - row_bytes : zero_row;
+        unsigned char *best = candidate;
+        unsigned char *scratch = candidate + row_bytes;
+        int best_type = PNG_FILTER_NONE;
+        long best_cost = -1;
+
+        for (int type = 0; type < PNG_FILTER_COUNT; type++)
+        {
+            long cost = 0;
+            filter_row(row, prev, row_bytes, job->channels, type, scratch);
+            for (int i = 0; i < row_bytes; i++)
+                cost += abs((signed char)scratch[i]);
+
+            if (best_cost < 0 || cost < best_cost)
+            {
+                unsigned char *swap = best;
+                best = scratch;
+                scratch = swap;
+                best_cost = cost;
+                best_type = type;
+            }
+        }
+
+        *out++ = (unsigned char)best_type;
+        memcpy(out, best, (size_t)row_bytes);
+        out += row_bytes;
+    }
+
+    free(candidate);
+    free(zero_row);
+    return 1;
+}
+
+// Filtra y comprime un grupo con deflate crudo. Los grupos intermedios
+// terminan con Z_SYNC_FLUSH (bloque vacío, alineado a byte, sin BFINAL) y el
+// último con Z_FINISH, de modo que concatenados forman un único flujo
+static void compress_group_task(void *ctx, int index)
+{
+    png_job_t *job = (png_job_t *)ctx;
+    png_group_t *group = &job->groups[index];
+    size_t line_bytes = (size_t)job->width * job->channels + 1;
+    int first_row = index * job->group_rows;
+    int last_row = first_row + job->group_rows;
+    int is_last = index == job->group_count - 1;
+
+    if (last_row > job->height)
+        last_row = job->height;
+
+    // Filas previas (ya filtradas por el grupo anterior) que llenan la ventana
+    int dictionary_rows = (int)((DEFLATE_WINDOW + line_bytes - 1) / line_bytes);
+    if (dictionary_rows > first_row)
+        dictionary_rows = first_row;
+
+    size_t dictionary_bytes = (size_t)dictionary_rows * line_bytes;
+    group->raw_bytes = (size_t)(last_row - first_row) * line_bytes;
+
+    unsigned char *filtered = buffer_pool_alloc(dictionary_bytes + group->raw_bytes);
+    if (!filtered || !filter_rows(job, first_row - dictionary_rows, last_row, filtered))
+    {
+        buffer_pool_free(filtered);
+        group->failed = 1;
+        return;
+    }
+
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (deflateInit2(&stream, job->level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+        buffer_pool_free(filtered);
+        group->failed = 1;
+        return;
+    }
+
+    if (dictionary_bytes > 0)
+    {
+        size_t window = dictionary_bytes < DEFLATE_WINDOW ? dictionary_bytes : DEFLATE_WINDOW;
+        deflateSetDictionary(&stream, filtered + dictionary_bytes - window, (uInt)window);
+    }
+
+    // deflateBound cubre Z_FINISH; el sync flush agrega a lo sumo un bloque vacío
+    size_t capacity = deflateBound(&stream, (uLong)group->raw_bytes) + 16;
+    group->data = buffer_pool_alloc(capacity);
+    if (!group->data)
+    {
+        deflateEnd(&stream);
+        buffer_pool_free(filtered);
+        group->failed = 1;
+        return;
+    }
+
+    stream.next_in = filtered + dictionary_bytes;
+    stream.avail_in = (uInt)group->raw_bytes;
+    stream.next_out = group->data;
+    stream.avail_out = (uInt)capacity;
+
+    int status = deflate(&stream, is_last ? Z_FINISH : Z_SYNC_FLUSH);
+    if ((is_last && status != Z_STREAM_END) || (!is_last && status != Z_OK) || stream.avail_in != 0)
+    {
+        group->failed = 1;
+    }
+
+    group->size = capacity - stream.avail_out;
+    group->adler = adler32(adler32(0L, Z_NULL, 0), filtered + dictionary_bytes, (uInt)group->raw_bytes);
+    group->crc = crc32(crc32(0L, Z_NULL, 0), group->data, (uInt)group->size);
+
+    deflateEnd(&stream);
+    buffer_pool_free(filtered);
+}
+
+static void put_uint32(unsigned char *out, uLong value)
+{
+    out[0] = (unsigned char)(value >> 24);
+    out[1] = (unsigned char)(value >> 16);
+    out[2] = (unsigned char)(value >> 8);
+    out[3] = (unsigned char)value;
+}
+
+// Emite un chunk PNG completo (longitud, tipo, datos, CRC)
+static void write_chunk(stbi_write_func *func, void *context, const char *type, unsigned char *data, size_t size)
+{
+    unsigned char header[8], footer[4];
+    uLong crc = crc32(crc32(0L, Z_NULL, 0), (const Bytef *)type, 4);
+
+    if (size > 0)
+        crc = crc32(crc, data, (uInt)size);
+
+    put_uint32(header, (uLong)size);
+    memcpy(header + 4, type, 4);
+    put_uint32(footer, crc);
+
+    func(context, header, sizeof(header));
+    if (size > 0)
+        func(context, data, (int)size);
+    func(context, footer, sizeof(footer));
+}
+
+// Un IDAT por grupo: el primero lleva la cabecera zlib y el último el Adler-32
+// de todo el flujo, combinado a partir de los de cada grupo
+static void write_image_data(stbi_write_func *func, void *context, const png_job_t *job)
+{
+    unsigned char zlib_header[2] = {0x78, 0};
+    int level_flag = job->level < 2 ? 0 : job->level < 6 ? 1 : job->level == 6 ? 2 : 3;
+    uLong adler = adler32(0L, Z_NULL, 0);
+
+    zlib_header[1] = (unsigned char)(level_flag << 6);
+    zlib_header[1] += (unsigned char)(31 - ((zlib_header[0] << 8) + zlib_header[1]) % 31);
+
+    for (int i = 0; i < job->group_count; i++)
+        adler = adler32_combine(adler, job->groups[i].adler, (z_off_t)job->groups[i].raw_bytes);
+
+    unsigned char adler_bytes[4];
+    put_uint32(adler_bytes, adler);
+
+    for (int i = 0; i < job->group_count; i++)
+    {
+        const png_group_t *group = &job->groups[i];
+        int is_first = i == 0;
+        int is_last = i == job->group_count - 1;
+        size_t size = group->size + (is_first ? sizeof(zlib_header) : 0) + (is_last ? sizeof(adler_bytes) : 0);
+        unsigned char header[8], footer[4];
+
+        uLong crc = crc32(crc32(0L, Z_NULL, 0), (const Bytef *)"IDAT", 4);
+        if (is_first)
+            crc = crc32(crc, zlib_header, sizeof(zlib_header));
+        crc = crc32_combine(crc, group->crc, (z_off_t)group->size);
+        if (is_last)
+            crc = crc32(crc, adler_bytes, sizeof(adler_bytes));
+
+        put_uint32(header, (uLong)size);
+        memcpy(header + 4, "IDAT", 4);
+        put_uint32(footer, crc);
+
+        func(context, header, sizeof(header));
+        if (is_first)
+            func(context, zlib_header, sizeof(zlib_header));
+        func(context, group->data, (int)group->size);
+        if (is_last)
+            func(context, adler_bytes, sizeof(adler_bytes));
+        func(context, footer, sizeof(footer));
+    }
+}
+
+int parallel_png_write_to_func(stbi_write_func *func, void *context, int width, int height, int channels,
+                               const unsigned char *data, int level)
+{
+    static const unsigned char signature[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+    static const unsigned char color_types[5] = {0, 0, 4, 2, 6}; // Gris, gris+alpha, RGB, RGBA
+
+    if (!data || width <= 0 || height <= 0 || channels < 1 || channels > 4)
+        return 0;
+
+    if (level < 0)
+        level = 0;
+    if (level > 9)
+        level = 9;
+
+    size_t line_bytes = (size_t)width * channels + 1;
+    int min_group_rows = (int)((MIN_GROUP_BYTES + line_bytes - 1) / line_bytes);
+
+    // Sin paralelismo real se comprime un único grupo: un flujo deflate normal,
+    // sin sync flush, sin cebar diccionarios ni combinar checksums
+    int concurrency = thread_pool_concurrency();
+    int group_count = concurrency <= 1 ? 1 : concurrency * 2; // Dos grupos por hilo para equilibrar carga
+    if (group_count > height / min_group_rows)
+        group_count = height / min_group_rows;
+    if (group_count < 1)
+        group_count = 1;
+
+    png_job_t job = {
+        .pixels = data,
+        .width = width,
+        .height = height,
+        .channels = channels,
+        .level = level,
+        .group_rows = (height + group_count - 1) / group_count,
+    };
+    job.group_count = (height + job.group_rows - 1) / job.group_rows;
+    job.groups = calloc((size_t)job.group_count, sizeof(png_group_t));
+    if (!job.groups)
+        return 0;
+
+    parallel_for(job.group_count, compress_group_task, &job);
+
+    int ok = 1;
+    for (int i = 0; i < job.group_count; i++)
+    {
+        if (job.groups[i].failed)
+        {
+            LOG_ERROR("PNG paralelo: error comprimiendo grupo %d de %d", i, job.group_count);
+            ok = 0;
+            break;
+        }
+    }
+
+    if (ok)
+    {
+        unsigned char ihdr[13];
+        put_uint32(ihdr, (uLong)width);
+        put_uint32(ihdr + 4, (uLong)height);
+        ihdr[8] = 8; // Bits por canal
+        ihdr[9] = color_types[channels];
+        ihdr[10] = 0; // Deflate
+        ihdr[11] = 0; // Filtrado adaptativo
+        ihdr[12] = 0; // Sin entrelazado
+
+        func(context, (void *)signature, sizeof(signature));
+        write_chunk(func, context, "IHDR", ihdr, sizeof(ihdr));
+        write_image_data(func, context, &job);
+        write_chunk(func, context, "IEND", NULL, 0);
+
+        LOG_DEBUG("PNG paralelo: %dx%d en %d grupos de %d filas (nivel %d)", width, height, job.group_count,
+                  job.group_rows, level);
+    }
+
+    for (int i = 0; i < job.group_count; i++)
+        buffer_pool_free(job.groups[i].data);
+    free(job.groups);
+    return ok;
+}
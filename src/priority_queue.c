@@ -2,44 +2,78 @@
 #include "logger.h"
 #include "image_processor.h"
 #include "server.h"
+#include "config.h"
+#include "thread_pool.h"
+#include "image_kernels.h"
+#include "buffer_pool.h"
 
 // Variables globales
 extern file_stats_t *get_file_stats(void);
 priority_queue_t processing_queue;
-pthread_t processor_thread;
+processor_worker_t processor_workers[MAX_PROCESSOR_WORKERS];
+int processor_worker_count = 0;
 int processor_running = 0;
 
-// Inicializar la cola de prioridad
+// Inicializar la cola de prioridad (un heap por worker)
 int init_priority_queue(void)
 {
     LOG_INFO("Inicializando cola de prioridad para procesamiento de archivos...");
 
+    int heap_count = server_config.thread_pool_size;
+    if (heap_count < 1)
+        heap_count = 1;
+    if (heap_count > MAX_PROCESSOR_WORKERS)
+        heap_count = MAX_PROCESSOR_WORKERS;
+
+    processing_queue.heap_count = heap_count;
     processing_queue.size = 0;
+    processing_queue.next_heap = 0;
+    processing_queue.idle_workers = 0;
     processing_queue.active = 1;
 
-    // Inicializar mutex y condition variables
-    if (pthread_mutex_init(&processing_queue.queue_mutex, NULL) != 0)
+    // Todos los lugares empiezan libres
+    processing_queue.free_count = MAX_QUEUE_SIZE;
+    for (int i = 0; i < MAX_QUEUE_SIZE; i++)
     {
-        LOG_ERROR("Error inicializando mutex de cola: %s", strerror(errno));
+        processing_queue.free_slots[i] = MAX_QUEUE_SIZE - 1 - i;
+    }
+    if (pthread_mutex_init(&processing_queue.slots_mutex, NULL) != 0)
+    {
+        LOG_ERROR("Error inicializando mutex de lugares de la cola: %s", strerror(errno));
         return 0;
     }
 
-    if (pthread_cond_init(&processing_queue.queue_not_empty, NULL) != 0)
+    for (int i = 0; i < heap_count; i++)
     {
-        LOG_ERROR("Error inicializando condition variable queue_not_empty: %s", strerror(errno));
-        pthread_mutex_destroy(&processing_queue.queue_mutex);
+        processing_queue.heaps[i].size = 0;
+        if (pthread_mutex_init(&processing_queue.heaps[i].mutex, NULL) != 0)
+        {
+            LOG_ERROR("Error inicializando mutex del heap %d: %s", i, strerror(errno));
+            while (--i >= 0)
+            {
+                pthread_mutex_destroy(&processing_queue.heaps[i].mutex);
+            }
+            pthread_mutex_destroy(&processing_queue.slots_mutex);
+            return 0;
+        }
+    }
+
+    // Inicializar mutex y condition variables (solo para dormir workers ociosos)
+    if (pthread_mutex_init(&processing_queue.queue_mutex, NULL) != 0)
+    {
+        LOG_ERROR("Error inicializando mutex de cola: %s", strerror(errno));
         return 0;
     }
 
-    if (pthread_cond_init(&processing_queue.queue_not_full, NULL) != 0)
+    if (pthread_cond_init(&processing_queue.queue_not_empty, NULL) != 0)
     {
-        LOG_ERROR("Error inicializando condition variable queue_not_full: %s", strerror(errno));
-        pthread_cond_destroy(&processing_queue.queue_not_empty);
+        LOG_ERROR("Error inicializando condition variable queue_not_empty: %s", strerror(errno));
         pthread_mutex_destroy(&processing_queue.queue_mutex);
         return 0;
     }
 
-    LOG_INFO("Cola de prioridad inicializada correctamente (capacidad: %d)", MAX_QUEUE_SIZE);
+    LOG_INFO("Cola de prioridad inicializada correctamente (capacidad: %d, %d heaps)",
+             MAX_QUEUE_SIZE, heap_count);
     return 1;
 }
 
@@ -53,26 +87,29 @@ void destroy_priority_queue(void)
 
     // Despertar a todos los hilos esperando
     pthread_cond_broadcast(&processing_queue.queue_not_empty);
-    pthread_cond_broadcast(&processing_queue.queue_not_full);
     pthread_mutex_unlock(&processing_queue.queue_mutex);
 
     // Destruir synchronization objects
     pthread_cond_destroy(&processing_queue.queue_not_empty);
-    pthread_cond_destroy(&processing_queue.queue_not_full);
     pthread_mutex_destroy(&processing_queue.queue_mutex);
+    for (int i = 0; i < processing_queue.heap_count; i++)
+    {
+        pthread_mutex_destroy(&processing_queue.heaps[i].mutex);
+    }
+    pthread_mutex_destroy(&processing_queue.slots_mutex);
 
     LOG_INFO("Cola de prioridad destruida");
 }
 
-// Comparar prioridad (menor tamaño = mayor prioridad)
+// Comparar prioridad (menor costo estimado = mayor prioridad)
 static int compare_priority(const priority_queue_item_t *a, const priority_queue_item_t *b)
 {
-    if (a->file_size < b->file_size)
+    if (a->cost < b->cost)
         return -1;
-    if (a->file_size > b->file_size)
+    if (a->cost > b->cost)
         return 1;
 
-    // Si tienen el mismo tamaño, prioridad por orden de llegada
+    // Si tienen el mismo costo, prioridad por orden de llegada
     if (a->received_time < b->received_time)
         return -1;
     if (a->received_time > b->received_time)
@@ -81,289 +118,416 @@ static int compare_priority(const priority_queue_item_t *a, const priority_queue
     return 0;
 }
 
-// Intercambiar elementos en la cola
-static void swap_items(int i, int j)
+// Elemento en la posición i de un heap
+static priority_queue_item_t *heap_item(const worker_heap_t *heap, int i)
+{
+    return &processing_queue.slots[heap->items[i]];
+}
+
+// Intercambiar elementos en un heap (solo los índices)
+static void swap_items(worker_heap_t *heap, int i, int j)
 {
-    priority_queue_item_t temp = processing_queue.items[i];
-    processing_queue.items[i] = processing_queue.items[j];
-    processing_queue.items[j] = temp;
+    int temp = heap->items[i];
+    heap->items[i] = heap->items[j];
+    heap->items[j] = temp;
+}
+
+// Tomar un lugar libre; reserve_queue_slot ya garantizó que existe
+static int acquire_slot(void)
+{
+    pthread_mutex_lock(&processing_queue.slots_mutex);
+    int slot = processing_queue.free_slots[--processing_queue.free_count];
+    pthread_mutex_unlock(&processing_queue.slots_mutex);
+    return slot;
+}
+
+// Devolver un lugar a la pila de libres
+static void release_slot(int slot)
+{
+    pthread_mutex_lock(&processing_queue.slots_mutex);
+    processing_queue.free_slots[processing_queue.free_count++] = slot;
+    pthread_mutex_unlock(&processing_queue.slots_mutex);
 }
 
 // Heapify hacia arriba (para inserción)
-static void heapify_up(int index)
+static void heapify_up(worker_heap_t *heap, int index)
 {
     if (index == 0)
         return;
 
     int parent = (index - 1) / 2;
 
-    if (compare_priority(&processing_queue.items[index], &processing_queue.items[parent]) < 0)
+    if (compare_priority(heap_item(heap, index), heap_item(heap, parent)) < 0)
     {
-        swap_items(index, parent);
-        heapify_up(parent);
+        swap_items(heap, index, parent);
+        heapify_up(heap, parent);
     }
 }
 
 // Heapify hacia abajo (para extracción)
-static void heapify_down(int index)
+static void heapify_down(worker_heap_t *heap, int index)
 {
     int left = 2 * index + 1;
     int right = 2 * index + 2;
     int smallest = index;
 
-    if (left < processing_queue.size &&
-        compare_priority(&processing_queue.items[left], &processing_queue.items[smallest]) < 0)
+    if (left < heap->size &&
+        compare_priority(heap_item(heap, left), heap_item(heap, smallest)) < 0)
     {
         smallest = left;
     }
 
-    if (right < processing_queue.size &&
-        compare_priority(&processing_queue.items[right], &processing_queue.items[smallest]) < 0)
+    if (right < heap->size &&
+        compare_priority(heap_item(heap, right), heap_item(heap, smallest)) < 0)
     {
         smallest = right;
     }
 
     if (smallest != index)
     {
-        swap_items(index, smallest);
-        heapify_down(smallest);
+        swap_items(heap, index, smallest);
+        heapify_down(heap, smallest);
+    }
+}
+
+// Extraer el elemento de mayor prioridad de un heap (si no está vacío)
+static int heap_pop(worker_heap_t *heap, priority_queue_item_t *item)
+{
+    pthread_mutex_lock(&heap->mutex);
+
+    if (heap->size == 0)
+    {
+        pthread_mutex_unlock(&heap->mutex);
+        return 0;
+    }
+
+    int slot = heap->items[0];
+    heap->size--;
+    if (heap->size > 0)
+    {
+        heap->items[0] = heap->items[heap->size];
+        heapify_down(heap, 0);
+    }
+
+    pthread_mutex_unlock(&heap->mutex);
+
+    // Fuera del heap nadie más referencia el lugar
+    *item = processing_queue.slots[slot];
+    release_slot(slot);
+    return 1;
+}
+
+// Reservar un lugar en la capacidad global de la cola
+static int reserve_queue_slot(void)
+{
+    int size = __atomic_load_n(&processing_queue.size, __ATOMIC_SEQ_CST);
+    while (size < MAX_QUEUE_SIZE)
+    {
+        if (__atomic_compare_exchange_n(&processing_queue.size, &size, size + 1, 0,
+                                        __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+uint64_t estimate_processing_cost(const file_upload_info_t *upload_info)
+{
+    uint64_t weight;
+    switch (upload_info->image_format)
+    {
+    case IMAGE_FORMAT_PNG:
+        weight = COST_WEIGHT_PNG;
+        break;
+    case IMAGE_FORMAT_GIF:
+        weight = COST_WEIGHT_GIF;
+        break;
+    case IMAGE_FORMAT_JPEG:
+    default:
+        weight = COST_WEIGHT_JPEG;
+        break;
+    }
+
+    uint64_t samples;
+    if (upload_info->image_width > 0 && upload_info->image_height > 0 && upload_info->image_channels > 0)
+    {
+        samples = (uint64_t)upload_info->image_width * (uint64_t)upload_info->image_height *
+                  (uint64_t)upload_info->image_channels;
+    }
+    else
+    {
+        samples = (uint64_t)upload_info->file_size * COST_SAMPLES_PER_BYTE;
+    }
+
+    return samples * weight;
+}
+
+int get_queued_jobs(queued_job_info_t *jobs, int max_jobs, uint64_t *total_cost)
+{
+    int count = 0;
+    uint64_t cost = 0;
+
+    for (int h = 0; h < processing_queue.heap_count; h++)
+    {
+        worker_heap_t *heap = &processing_queue.heaps[h];
+        pthread_mutex_lock(&heap->mutex);
+        for (int i = 0; i < heap->size; i++)
+        {
+            const priority_queue_item_t *item = heap_item(heap, i);
+            cost += item->cost;
+            if (count < max_jobs)
+            {
+                queued_job_info_t *job = &jobs[count++];
+                strncpy(job->filename, item->upload_info.original_filename, sizeof(job->filename) - 1);
+                job->filename[sizeof(job->filename) - 1] = '\0';
+                job->width = item->upload_info.image_width;
+                job->height = item->upload_info.image_height;
+                job->channels = item->upload_info.image_channels;
+                job->format = item->upload_info.image_format;
+                job->file_size = item->file_size;
+                job->cost = item->cost;
+            }
+        }
+        pthread_mutex_unlock(&heap->mutex);
+    }
+
+    if (total_cost)
+        *total_cost = cost;
+    return count;
+}
+
+// Bytes de uploads encolados o en proceso que viajan en memoria
+static size_t memory_job_bytes = 0;
+
+int reserve_memory_job(size_t bytes)
+{
+    size_t budget = (size_t)server_config.memory_job_budget_mb * 1024 * 1024;
+    size_t current = __atomic_load_n(&memory_job_bytes, __ATOMIC_RELAXED);
+    while (current + bytes <= budget)
+    {
+        if (__atomic_compare_exchange_n(&memory_job_bytes, &current, current + bytes, 0,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        {
+            return 1;
+        }
     }
+    return 0;
+}
+
+void release_memory_job(size_t bytes)
+{
+    __atomic_sub_fetch(&memory_job_bytes, bytes, __ATOMIC_RELAXED);
+}
+
+size_t get_memory_job_bytes(void)
+{
+    return __atomic_load_n(&memory_job_bytes, __ATOMIC_RELAXED);
 }
 
 // Agregar archivo a la cola de procesamiento
 int enqueue_file_for_processing(const file_upload_info_t *upload_info,
                                 const char *temp_filepath,
+                                int spool_fd,
                                 const char *client_ip,
                                 int client_socket)
 {
 
-    if (!upload_info || !temp_filepath || !client_ip)
+    if (!upload_info || !client_ip || (!temp_filepath && spool_fd < 0 && !upload_info->file_data))
     {
         LOG_ERROR("Parámetros inválidos para encolar archivo");
         return -1;
     }
 
-    pthread_mutex_lock(&processing_queue.queue_mutex);
-
-    // Verificar si la cola está llena
-    if (processing_queue.size >= MAX_QUEUE_SIZE)
+    // Verificar que el archivo temporal existe y es válido (sin tomar ningún lock)
+    struct stat file_stat;
+    if (spool_fd >= 0 && (fstat(spool_fd, &file_stat) != 0 || !S_ISREG(file_stat.st_mode)))
     {
-        LOG_ERROR("Cola de procesamiento llena (%d/%d)", processing_queue.size, MAX_QUEUE_SIZE);
-        pthread_mutex_unlock(&processing_queue.queue_mutex);
+        LOG_ERROR("Spool anónimo inválido (fd %d)", spool_fd);
         return -1;
     }
 
-    // Verificar que el archivo temporal existe y es válido
-    struct stat file_stat;
-    if (stat(temp_filepath, &file_stat) != 0)
+    if (temp_filepath && stat(temp_filepath, &file_stat) != 0)
     {
         LOG_ERROR("No se puede acceder al archivo temporal: %s", temp_filepath);
-        pthread_mutex_unlock(&processing_queue.queue_mutex);
         return -1;
     }
 
-    if (!S_ISREG(file_stat.st_mode))
+    if (temp_filepath && !S_ISREG(file_stat.st_mode))
     {
         LOG_ERROR("El path temporal no es un archivo regular: %s", temp_filepath);
-        pthread_mutex_unlock(&processing_queue.queue_mutex);
         return -1;
     }
 
-    // Crear elemento para la cola
-    priority_queue_item_t new_item;
-    memset(&new_item, 0, sizeof(new_item));
-
-    // Copiar información
-    new_item.upload_info = *upload_info;
-    new_item.file_size = upload_info->file_size;
-    new_item.received_time = time(NULL);
-    new_item.client_socket = client_socket;
-    new_item.priority = (int)upload_info->file_size; // Menor tamaño = mayor prioridad
-
-    strncpy(new_item.temp_filepath, temp_filepath, sizeof(new_item.temp_filepath) - 1);
-    strncpy(new_item.client_ip, client_ip, sizeof(new_item.client_ip) - 1);
-
-    // Insertar en la cola manteniendo orden de prioridad (min-heap)
-    int pos = processing_queue.size;
-    processing_queue.items[pos] = new_item;
-    processing_queue.size++;
-
-    // Bubble up para mantener propiedad de min-heap
-    while (pos > 0)
+    // Verificar si la cola está llena
+    if (!reserve_queue_slot())
     {
-        int parent = (pos - 1) / 2;
-        if (processing_queue.items[parent].priority <= processing_queue.items[pos].priority)
-        {
-            break;
-        }
+        LOG_ERROR("Cola de procesamiento llena (%d/%d)", MAX_QUEUE_SIZE, MAX_QUEUE_SIZE);
+        return -1;
+    }
 
-        // Intercambiar con padre
-        priority_queue_item_t temp = processing_queue.items[parent];
-        processing_queue.items[parent] = processing_queue.items[pos];
-        processing_queue.items[pos] = temp;
+    // Crear elemento para la cola en un lugar propio (ningún heap lo referencia aún)
+    int slot = acquire_slot();
+    priority_queue_item_t *new_item = &processing_queue.slots[slot];
+    memset(new_item, 0, sizeof(*new_item));
 
-        pos = parent;
-    }
+    // Copiar información
+    new_item->upload_info = *upload_info;
+    new_item->file_size = upload_info->file_size;
+    new_item->received_time = time(NULL);
+    new_item->client_socket = client_socket;
+    new_item->cost = estimate_processing_cost(upload_info); // Menor costo = mayor prioridad
+
+    new_item->spool_fd = spool_fd;
+    new_item->in_memory = temp_filepath == NULL && spool_fd < 0;
+    if (temp_filepath)
+        strncpy(new_item->temp_filepath, temp_filepath, sizeof(new_item->temp_filepath) - 1);
+    strncpy(new_item->client_ip, client_ip, sizeof(new_item->client_ip) - 1);
+
+    // Una vez en el heap, un worker puede sacarlo y reutilizar el lugar
+    uint64_t cost = new_item->cost;
+
+    // Repartir entre los heaps de los workers (round robin); el robo de
+    // trabajo equilibra la carga si un worker se atrasa
+    unsigned int heap_index = __atomic_fetch_add(&processing_queue.next_heap, 1, __ATOMIC_RELAXED) %
+                              (unsigned int)processing_queue.heap_count;
+    worker_heap_t *heap = &processing_queue.heaps[heap_index];
+
+    pthread_mutex_lock(&heap->mutex);
+    heap->items[heap->size] = slot;
+    heap->size++;
+    heapify_up(heap, heap->size - 1);
+    int heap_size = heap->size;
+    pthread_mutex_unlock(&heap->mutex);
 
     // Logging detallado
     LOG_INFO("   ARCHIVO ENCOLADO:");
-    LOG_INFO("   Archivo: %s (%zu bytes)", upload_info->original_filename, upload_info->file_size);
+    LOG_INFO("   Archivo: %s (%zu bytes, %dx%d, %d canales, costo %llu)", upload_info->original_filename,
+             upload_info->file_size, upload_info->image_width, upload_info->image_height,
+             upload_info->image_channels, (unsigned long long)cost);
     LOG_INFO("   Cliente: %s", client_ip);
-    LOG_INFO("   Posición en cola: %d/%d", processing_queue.size, MAX_QUEUE_SIZE);
+    LOG_INFO("   Heap del worker %u: %d elementos (total en cola: %d/%d)",
+             heap_index, heap_size, get_queue_size(), MAX_QUEUE_SIZE);
 
-    // Mostrar próximos archivos a procesar
-    LOG_INFO("   Orden de procesamiento (próximos 3):");
-    int show_count = (processing_queue.size < 3) ? processing_queue.size : 3;
-    for (int i = 0; i < show_count; i++)
+    // Notificar solo si hay workers dormidos
+    if (__atomic_load_n(&processing_queue.idle_workers, __ATOMIC_SEQ_CST) > 0)
     {
-        LOG_INFO("     %d. %s (%zu bytes)",
-                 i + 1,
-                 processing_queue.items[i].upload_info.original_filename,
-                 processing_queue.items[i].file_size);
+        pthread_mutex_lock(&processing_queue.queue_mutex);
+        pthread_cond_signal(&processing_queue.queue_not_empty);
+        pthread_mutex_unlock(&processing_queue.queue_mutex);
     }
 
-    // Notificar al hilo procesador
-    pthread_cond_signal(&processing_queue.queue_not_empty);
-    pthread_mutex_unlock(&processing_queue.queue_mutex);
+    return 0;
+}
+
+// Tomar trabajo del heap propio o, si está vacío, robarlo de otro worker
+static int take_work(int worker_id, priority_queue_item_t *item)
+{
+    int heap_count = processing_queue.heap_count;
+    int own = worker_id % heap_count;
+
+    for (int i = 0; i < heap_count; i++)
+    {
+        int victim = (own + i) % heap_count;
+        if (heap_pop(&processing_queue.heaps[victim], item))
+        {
+            __atomic_fetch_sub(&processing_queue.size, 1, __ATOMIC_SEQ_CST);
+            if (victim != own)
+            {
+                LOG_DEBUG("Worker %d robó trabajo del heap %d", worker_id, victim);
+            }
+            return 1;
+        }
+    }
 
     return 0;
 }
 
 // Extraer archivo de la cola para procesamiento
-int dequeue_file_for_processing(priority_queue_item_t *item)
+int dequeue_file_for_processing(int worker_id, priority_queue_item_t *item)
 {
     if (!item)
     {
         return -1;
     }
 
-    pthread_mutex_lock(&processing_queue.queue_mutex);
+    if (take_work(worker_id, item))
+    {
+        LOG_DEBUG("Archivo extraído de cola: %s (%zu bytes) - Elementos restantes: %d",
+                  item->upload_info.original_filename, item->file_size, get_queue_size());
+        return 0;
+    }
 
-    // Esperar hasta que haya elementos o se termine el procesador
+    // Sin trabajo en ningún heap: dormir hasta que se encole algo
     struct timespec timeout;
     clock_gettime(CLOCK_REALTIME, &timeout);
     timeout.tv_sec += 1; // 1 segundo de timeout
 
-    while (processing_queue.size == 0 && processing_queue.active)
-    {
-        int wait_result = pthread_cond_timedwait(&processing_queue.queue_not_empty,
-                                                 &processing_queue.queue_mutex,
-                                                 &timeout);
-        if (wait_result == ETIMEDOUT)
-        {
-            pthread_mutex_unlock(&processing_queue.queue_mutex);
-            return -1; // Timeout
-        }
-    }
+    pthread_mutex_lock(&processing_queue.queue_mutex);
+    __atomic_fetch_add(&processing_queue.idle_workers, 1, __ATOMIC_SEQ_CST);
 
-    // Verificar si debemos terminar
-    if (!processing_queue.active)
+    int wait_result = 0;
+    while (__atomic_load_n(&processing_queue.size, __ATOMIC_SEQ_CST) == 0 &&
+           processing_queue.active && processor_running && wait_result != ETIMEDOUT)
     {
-        pthread_mutex_unlock(&processing_queue.queue_mutex);
-        return -1;
+        wait_result = pthread_cond_timedwait(&processing_queue.queue_not_empty,
+                                             &processing_queue.queue_mutex,
+                                             &timeout);
     }
 
-    // Verificar que hay elementos
-    if (processing_queue.size == 0)
+    __atomic_fetch_sub(&processing_queue.idle_workers, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&processing_queue.queue_mutex);
+
+    // Verificar si debemos terminar
+    if (!processing_queue.active || !processor_running)
     {
-        pthread_mutex_unlock(&processing_queue.queue_mutex);
         return -1;
     }
 
-    // Extraer elemento con mayor prioridad (índice 0 del min-heap)
-    *item = processing_queue.items[0];
-    processing_queue.size--;
-
-    // Reorganizar heap si quedan elementos
-    if (processing_queue.size > 0)
+    if (take_work(worker_id, item))
     {
-        // Mover último elemento al inicio
-        processing_queue.items[0] = processing_queue.items[processing_queue.size];
-
-        // Bubble down para mantener propiedad de min-heap
-        int pos = 0;
-        while (1)
-        {
-            int left_child = 2 * pos + 1;
-            int right_child = 2 * pos + 2;
-            int smallest = pos;
-
-            // Encontrar el elemento más pequeño entre padre e hijos
-            if (left_child < processing_queue.size &&
-                processing_queue.items[left_child].priority < processing_queue.items[smallest].priority)
-            {
-                smallest = left_child;
-            }
-
-            if (right_child < processing_queue.size &&
-                processing_queue.items[right_child].priority < processing_queue.items[smallest].priority)
-            {
-                smallest = right_child;
-            }
-
-            // Si el padre ya es el más pequeño, terminamos
-            if (smallest == pos)
-            {
-                break;
-            }
-
-            // Intercambiar con el hijo más pequeño
-            priority_queue_item_t temp = processing_queue.items[pos];
-            processing_queue.items[pos] = processing_queue.items[smallest];
-            processing_queue.items[smallest] = temp;
-
-            pos = smallest;
-        }
+        LOG_DEBUG("Archivo extraído de cola: %s (%zu bytes) - Elementos restantes: %d",
+                  item->upload_info.original_filename, item->file_size, get_queue_size());
+        return 0;
     }
 
-    LOG_DEBUG("Archivo extraído de cola: %s (%zu bytes) - Elementos restantes: %d",
-              item->upload_info.original_filename, item->file_size, processing_queue.size);
-
-    pthread_mutex_unlock(&processing_queue.queue_mutex);
-    return 0;
+    return -1; // Timeout
 }
 
 // Funciones auxiliares
 int is_queue_empty(void)
 {
-    pthread_mutex_lock(&processing_queue.queue_mutex);
-    int empty = (processing_queue.size == 0);
-    pthread_mutex_unlock(&processing_queue.queue_mutex);
-    return empty;
+    return get_queue_size() == 0;
 }
 
 int is_queue_full(void)
 {
-    pthread_mutex_lock(&processing_queue.queue_mutex);
-    int full = (processing_queue.size >= MAX_QUEUE_SIZE);
-    pthread_mutex_unlock(&processing_queue.queue_mutex);
-    return full;
+    return get_queue_size() >= MAX_QUEUE_SIZE;
 }
 
 int get_queue_size(void)
 {
-    pthread_mutex_lock(&processing_queue.queue_mutex);
-    int size = processing_queue.size;
-    pthread_mutex_unlock(&processing_queue.queue_mutex);
-    return size;
+    return __atomic_load_n(&processing_queue.size, __ATOMIC_SEQ_CST);
 }
 
 void print_queue_status(void)
 {
-    pthread_mutex_lock(&processing_queue.queue_mutex);
-
     LOG_INFO("Estado de cola de procesamiento:");
-    LOG_INFO("  Tamaño actual: %d/%d", processing_queue.size, MAX_QUEUE_SIZE);
+    LOG_INFO("  Tamaño actual: %d/%d", get_queue_size(), MAX_QUEUE_SIZE);
     LOG_INFO("  Estado: %s", processing_queue.active ? "ACTIVA" : "INACTIVA");
 
-    if (processing_queue.size > 0)
+    for (int i = 0; i < processing_queue.heap_count; i++)
     {
-        LOG_INFO("  Próximo archivo: %s (%zu bytes)",
-                 processing_queue.items[0].upload_info.original_filename,
-                 processing_queue.items[0].file_size);
+        worker_heap_t *heap = &processing_queue.heaps[i];
+        pthread_mutex_lock(&heap->mutex);
+        if (heap->size > 0)
+        {
+            LOG_INFO("  Heap %d: %d elementos, próximo: %s (%zu bytes, costo %llu)", i, heap->size,
+                     heap_item(heap, 0)->upload_info.original_filename,
+                     heap_item(heap, 0)->file_size, (unsigned long long)heap_item(heap, 0)->cost);
+        }
+        pthread_mutex_unlock(&heap->mutex);
     }
-
-    pthread_mutex_unlock(&processing_queue.queue_mutex);
 }
 
 // Función para enviar respuestas de éxito con información de procesamiento
@@ -424,46 +588,88 @@ void get_queue_statistics(int *total_files, int *total_bytes, int *avg_file_size
         return;
     }
 
-    pthread_mutex_lock(&processing_queue.queue_mutex);
-
-    *total_files = processing_queue.size;
+    *total_files = 0;
     *total_bytes = 0;
 
-    for (int i = 0; i < processing_queue.size; i++)
+    for (int h = 0; h < processing_queue.heap_count; h++)
     {
-        *total_bytes += (int)processing_queue.items[i].file_size;
+        worker_heap_t *heap = &processing_queue.heaps[h];
+        pthread_mutex_lock(&heap->mutex);
+        *total_files += heap->size;
+        for (int i = 0; i < heap->size; i++)
+        {
+            *total_bytes += (int)heap_item(heap, i)->file_size;
+        }
+        pthread_mutex_unlock(&heap->mutex);
     }
 
     *avg_file_size = (*total_files > 0) ? (*total_bytes / *total_files) : 0;
+}
 
-    pthread_mutex_unlock(&processing_queue.queue_mutex);
+// Copiar estadísticas de los workers
+int get_worker_statistics(processor_worker_stats_t *stats)
+{
+    if (!stats)
+    {
+        return 0;
+    }
+
+    int count = processor_worker_count;
+    for (int i = 0; i < count; i++)
+    {
+        pthread_mutex_lock(&processor_workers[i].stats_mutex);
+        stats[i] = processor_workers[i].stats;
+        pthread_mutex_unlock(&processor_workers[i].stats_mutex);
+    }
+
+    return count;
 }
 
-// Hilo procesador de archivos
-void *file_processor_thread(void *arg)
+// Registrar el resultado de un archivo en las estadísticas del worker
+static void record_worker_result(processor_worker_t *worker, int success, size_t bytes, double seconds)
 {
+    pthread_mutex_lock(&worker->stats_mutex);
+    if (success)
+    {
+        worker->stats.files_processed++;
+        worker->stats.bytes_processed += bytes;
+    }
+    else
+    {
+        worker->stats.files_failed++;
+    }
+    worker->stats.busy_seconds += seconds;
+    worker->stats.busy = 0;
+    pthread_mutex_unlock(&worker->stats_mutex);
+}
 
-    (void)arg; // Suprimir warning
-    LOG_INFO("Hilo procesador de archivos iniciado");
+// Hilo procesador de archivos (uno por worker del pool)
+void *file_processor_thread(void *arg)
+{
+    processor_worker_t *worker = (processor_worker_t *)arg;
+    LOG_INFO("Worker de procesamiento %d iniciado", worker->id);
 
     while (processor_running)
     {
         priority_queue_item_t item;
 
-        // Extraer elemento de la cola con timeout
-        int dequeue_result = dequeue_file_for_processing(&item);
+        // Extraer elemento del heap propio (o robado) con timeout; la espera
+        // ya ocurre dentro de dequeue_file_for_processing
+        int dequeue_result = dequeue_file_for_processing(worker->id, &item);
 
         if (dequeue_result != 0)
         {
-            if (processor_running)
-            {
-                // Si hay error y el procesador debe seguir corriendo, esperar un poco
-                usleep(100000); // 100ms
-            }
             continue;
         }
 
-        LOG_INFO("=== PROCESANDO ARCHIVO ===");
+        struct timespec started;
+        clock_gettime(CLOCK_MONOTONIC, &started);
+
+        pthread_mutex_lock(&worker->stats_mutex);
+        worker->stats.busy = 1;
+        pthread_mutex_unlock(&worker->stats_mutex);
+
+        LOG_INFO("=== PROCESANDO ARCHIVO (worker %d) ===", worker->id);
         LOG_INFO("Archivo: %s (%zu bytes) desde %s",
                  item.upload_info.original_filename,
                  item.file_size,
@@ -471,11 +677,12 @@ void *file_processor_thread(void *arg)
         LOG_INFO("Cola restante: %d archivos", get_queue_size());
 
         // Verificar que el archivo temporal existe
-        if (access(item.temp_filepath, F_OK) != 0)
+        if (!item.in_memory && item.spool_fd < 0 && access(item.temp_filepath, F_OK) != 0)
         {
             LOG_ERROR("Archivo temporal no encontrado: %s", item.temp_filepath);
             send_error_response(item.client_socket, 500, "Internal Server Error");
-            close(item.client_socket);
+            release_client_connection(item.client_socket);
+            record_worker_result(worker, 0, item.file_size, 0.0);
             continue;
         }
 
@@ -483,9 +690,25 @@ void *file_processor_thread(void *arg)
         processed_image_info_t result;
         memset(&result, 0, sizeof(result));
 
-        int processing_result = process_image_complete(item.temp_filepath,
+        // Los jobs en memoria leen el body de la conexión, que sigue viva
+        // hasta release_client_connection
+        int processing_result;
+        if (item.in_memory)
+        {
+            processing_result = process_image_from_memory((const unsigned char *)item.upload_info.file_data,
+                                                          item.file_size, item.upload_info.original_filename,
+                                                          &result);
+        }
+        else if (item.spool_fd >= 0)
+        {
+            processing_result = process_image_from_fd(item.spool_fd, item.upload_info.original_filename, &result);
+        }
+        else
+        {
+            processing_result = process_image_complete(item.temp_filepath,
                                                        item.upload_info.original_filename,
                                                        &result);
+        }
 
         if (processing_result == 0)
         {
@@ -514,8 +737,16 @@ void *file_processor_thread(void *arg)
             update_file_stats(0, item.file_size, item.upload_info.original_filename);
         }
 
-        // Limpiar archivo temporal
-        if (cleanup_temp_image(item.temp_filepath))
+        // Limpiar archivo temporal o devolver el presupuesto en memoria
+        if (item.in_memory)
+        {
+            release_memory_job(item.file_size);
+        }
+        else if (item.spool_fd >= 0)
+        {
+            close(item.spool_fd); // El kernel libera el spool anónimo al cerrarlo
+        }
+        else if (cleanup_temp_image(item.temp_filepath))
         {
             LOG_DEBUG("Archivo temporal limpiado: %s", item.temp_filepath);
         }
@@ -524,17 +755,23 @@ void *file_processor_thread(void *arg)
             LOG_WARNING("No se pudo limpiar archivo temporal: %s", item.temp_filepath);
         }
 
-        // Cerrar socket del cliente
-        close(item.client_socket);
+        // Devolver la conexión a su reactor para enviar la respuesta
+        release_client_connection(item.client_socket);
+
+        struct timespec finished;
+        clock_gettime(CLOCK_MONOTONIC, &finished);
+        record_worker_result(worker, processing_result == 0, item.file_size,
+                             (finished.tv_sec - started.tv_sec) +
+                                 (finished.tv_nsec - started.tv_nsec) / 1e9);
 
         LOG_INFO("=== PROCESAMIENTO COMPLETADO ===");
     }
 
-    LOG_INFO("Hilo procesador de archivos terminado");
+    LOG_INFO("Worker de procesamiento %d terminado", worker->id);
     return NULL;
 }
 
-// Iniciar el procesador de archivos
+// Iniciar el pool de workers del procesador de archivos
 int start_file_processor(void)
 {
     if (processor_running)
@@ -543,22 +780,60 @@ int start_file_processor(void)
         return 1;
     }
 
-    LOG_INFO("Iniciando procesador de archivos...");
+    int worker_count = server_config.thread_pool_size;
+    if (worker_count < 1)
+        worker_count = 1;
+    if (worker_count > MAX_PROCESSOR_WORKERS)
+        worker_count = MAX_PROCESSOR_WORKERS;
+
+    LOG_INFO("Iniciando procesador de archivos con %d workers...", worker_count);
+
+    // Pool de cómputo compartido para paralelizar cada imagen por bandas
+    if (!thread_pool_init(server_config.compute_threads))
+    {
+        LOG_WARNING("No se pudo iniciar el pool de cómputo, las imágenes se procesarán en un solo hilo");
+    }
+    LOG_INFO("Kernels de histograma: %s", image_kernels_implementation_name());
+
+    // Buffers de pixeles y de archivos codificados reutilizados entre imágenes
+    buffer_pool_configure((size_t)server_config.buffer_pool_mb * 1024 * 1024, server_config.buffer_pool_hugepages);
 
     processor_running = 1;
+    processor_worker_count = 0;
 
-    if (pthread_create(&processor_thread, NULL, file_processor_thread, NULL) != 0)
+    for (int i = 0; i < worker_count; i++)
+    {
+        processor_worker_t *worker = &processor_workers[i];
+        memset(worker, 0, sizeof(*worker));
+        worker->id = i;
+        pthread_mutex_init(&worker->stats_mutex, NULL);
+
+        if (pthread_create(&worker->thread, NULL, file_processor_thread, worker) != 0)
+        {
+            LOG_ERROR("Error creando worker procesador %d: %s", i, strerror(errno));
+            pthread_mutex_destroy(&worker->stats_mutex);
+            break;
+        }
+        processor_worker_count++;
+    }
+
+    if (processor_worker_count == 0)
     {
-        LOG_ERROR("Error creando hilo procesador: %s", strerror(errno));
         processor_running = 0;
+        thread_pool_destroy();
         return 0;
     }
 
+    if (processor_worker_count < worker_count)
+    {
+        LOG_WARNING("Procesador iniciado con %d de %d workers", processor_worker_count, worker_count);
+    }
+
     LOG_INFO("Procesador de archivos iniciado correctamente");
     return 1;
 }
 
-// Detener el procesador de archivos
+// Detener el pool de workers
 void stop_file_processor(void)
 {
     if (!processor_running)
@@ -570,13 +845,30 @@ void stop_file_processor(void)
 
     processor_running = 0;
 
-    // Despertar el hilo procesador
+    // Despertar a todos los workers que esperan en la cola
     pthread_mutex_lock(&processing_queue.queue_mutex);
-    pthread_cond_signal(&processing_queue.queue_not_empty);
+    pthread_cond_broadcast(&processing_queue.queue_not_empty);
     pthread_mutex_unlock(&processing_queue.queue_mutex);
 
-    // Esperar a que termine el hilo
-    pthread_join(processor_thread, NULL);
+    // Esperar a que terminen los workers
+    for (int i = 0; i < processor_worker_count; i++)
+    {
+        processor_worker_t *worker = &processor_workers[i];
+        pthread_join(worker->thread, NULL);
+
+        LOG_INFO("Worker %d: %lu procesados, %lu fallidos, %llu bytes, %.2f s ocupado",
+                 worker->id, worker->stats.files_processed, worker->stats.files_failed,
+                 worker->stats.bytes_processed, worker->stats.busy_seconds);
+        pthread_mutex_destroy(&worker->stats_mutex);
+    }
+    processor_worker_count = 0;
+
+    thread_pool_destroy();
+
+    buffer_pool_stats_t pool_stats;
+    buffer_pool_get_stats(&pool_stats);
+    LOG_INFO("Pool de buffers: %lu aciertos, %lu fallos, %lu liberados, %zu bytes retenidos",
+             pool_stats.hits, pool_stats.misses, pool_stats.releases, pool_stats.cached_bytes);
 
     LOG_INFO("Procesador de archivos detenido");
 }
@@ -584,52 +876,20 @@ void stop_file_processor(void)
 // Función para debugging: imprimir estado completo de la cola
 void debug_print_queue(void)
 {
-    pthread_mutex_lock(&processing_queue.queue_mutex);
     LOG_DEBUG("=== Estado actual de la cola ===");
-    LOG_DEBUG("Tamaño: %d elementos", processing_queue.size);
-    for (int i = 0; i < processing_queue.size; i++)
+    LOG_DEBUG("Tamaño: %d elementos", get_queue_size());
+    for (int h = 0; h < processing_queue.heap_count; h++)
     {
-        LOG_DEBUG("  [%d] %s - %zu bytes (recibido: %ld)", i,
-                  processing_queue.items[i].upload_info.original_filename,
-                  processing_queue.items[i].file_size,
-                  processing_queue.items[i].received_time);
-    }
-    LOG_DEBUG("===============================");
-    pthread_mutex_unlock(&processing_queue.queue_mutex);
-}
-
-// Función para mostrar estado detallado de la cola
-void print_detailed_queue_status(void)
-{
-    pthread_mutex_lock(&processing_queue.queue_mutex);
-
-    LOG_INFO("=== ESTADO DE LA COLA DE PROCESAMIENTO ===");
-    LOG_INFO("Elementos en cola: %d/%d", processing_queue.size, MAX_QUEUE_SIZE);
-    LOG_INFO("Estado del procesador: %s", processor_running ? "ACTIVO" : "INACTIVO");
-
-    if (processing_queue.size > 0)
-    {
-        LOG_INFO("Próximos archivos a procesar:");
-        for (int i = 0; i < processing_queue.size && i < 5; i++)
-        {
-            LOG_INFO("  %d. %s (%zu bytes) - Cliente: %s",
-                     i + 1,
-                     processing_queue.items[i].upload_info.original_filename,
-                     processing_queue.items[i].file_size,
-                     processing_queue.items[i].client_ip);
-        }
-
-        if (processing_queue.size > 5)
+        worker_heap_t *heap = &processing_queue.heaps[h];
+        pthread_mutex_lock(&heap->mutex);
+        for (int i = 0; i < heap->size; i++)
         {
-            LOG_INFO("  ... y %d archivos más", processing_queue.size - 5);
+            LOG_DEBUG("  [%d:%d] %s - %zu bytes (recibido: %ld)", h, i,
+                      heap_item(heap, i)->upload_info.original_filename,
+                      heap_item(heap, i)->file_size,
+                      heap_item(heap, i)->received_time);
         }
+        pthread_mutex_unlock(&heap->mutex);
     }
-    else
-    {
-        LOG_INFO("Cola vacía - esperando archivos...");
-    }
-
-    LOG_INFO("==========================================");
-
-    pthread_mutex_unlock(&processing_queue.queue_mutex);
+    LOG_DEBUG("===============================");
 }
@@ -0,0 +1,214 @@
+#include "scanner.h"
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SCANNER_X86 1
+#endif
+
+typedef const char *(*scan_fn_t)(const char *, size_t, const char *, size_t);
+
+static scan_fn_t active_scan = NULL;
+static scanner_impl_t active_impl = SCANNER_IMPL_SCALAR;
+static pthread_once_t scanner_once = PTHREAD_ONCE_INIT;
+
+// Versión escalar: memchr del primer byte y verificación del resto
+static const char *scan_find_scalar(const char *haystack, size_t haystack_len,
+                                    const char *needle, size_t needle_len)
+{
+    if (needle_len == 0)
+        return haystack;
+
+    const char *pos = haystack;
+    const char *end = haystack + haystack_len;
+
+    while ((size_t)(end - pos) >= needle_len)
+    {
+        pos = memchr(pos, needle[0], (end - pos) - needle_len + 1);
+        if (!pos)
+            return NULL;
+        if (memcmp(pos + 1, needle + 1, needle_len - 1) == 0)
+            return pos;
+        pos++;
+    }
+
+    return NULL;
+}
+
+#ifdef SCANNER_X86
+
+// Comparar primer y último byte del needle en bloques de 16 bytes; solo las
+// posiciones candidatas (ambos bytes coinciden) se verifican con memcmp
+__attribute__((target("sse2")))
+static const char *scan_find_sse2(const char *haystack, size_t haystack_len,
+                                  const char *needle, size_t needle_len)
+{
+    if (needle_len == 0)
+        return haystack;
+    if (haystack_len < needle_len)
+        return NULL;
+
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last = _mm_set1_epi8(needle[needle_len - 1]);
+    size_t i = 0;
+
+    for (; i + needle_len - 1 + 16 <= haystack_len; i += 16)
+    {
+        __m128i block_first = _mm_loadu_si128((const __m128i *)(haystack + i));
+        __m128i block_last = _mm_loadu_si128((const __m128i *)(haystack + i + needle_len - 1));
+        unsigned mask = (unsigned)_mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(first, block_first), _mm_cmpeq_epi8(last, block_last)));
+
+        while (mask)
+        {
+            int bit = __builtin_ctz(mask);
+            if (needle_len <= 2 || memcmp(haystack + i + bit + 1, needle + 1, needle_len - 2) == 0)
+                return haystack + i + bit;
+            mask &= mask - 1;
+        }
+    }
+
+    return scan_find_scalar(haystack + i, haystack_len - i, needle, needle_len);
+}
+
+// Misma estrategia con bloques de 32 bytes
+__attribute__((target("avx2")))
+static const char *scan_find_avx2(const char *haystack, size_t haystack_len,
+                                  const char *needle, size_t needle_len)
+{
+    if (needle_len == 0)
+        return haystack;
+    if (haystack_len < needle_len)
+        return NULL;
+
+    const __m256i first = _mm256_set1_epi8(needle[0]);
+    const __m256i last = _mm256_set1_epi8(needle[needle_len - 1]);
+    size_t i = 0;
+
+    // Bucle principal de 64 bytes: un solo test para descartar ambos bloques
+    for (; i + needle_len - 1 + 64 <= haystack_len; i += 64)
+    {
+        const char *p = haystack + i;
+        __m256i eq_lo = _mm256_and_si256(
+            _mm256_cmpeq_epi8(first, _mm256_loadu_si256((const __m256i *)p)),
+            _mm256_cmpeq_epi8(last, _mm256_loadu_si256((const __m256i *)(p + needle_len - 1))));
+        __m256i eq_hi = _mm256_and_si256(
+            _mm256_cmpeq_epi8(first, _mm256_loadu_si256((const __m256i *)(p + 32))),
+            _mm256_cmpeq_epi8(last, _mm256_loadu_si256((const __m256i *)(p + 32 + needle_len - 1))));
+
+        if (_mm256_testz_si256(_mm256_or_si256(eq_lo, eq_hi), _mm256_or_si256(eq_lo, eq_hi)))
+            continue;
+
+        uint64_t mask = (uint32_t)_mm256_movemask_epi8(eq_lo) |
+                        ((uint64_t)(uint32_t)_mm256_movemask_epi8(eq_hi) << 32);
+        while (mask)
+        {
+            int bit = __builtin_ctzll(mask);
+            if (needle_len <= 2 || memcmp(p + bit + 1, needle + 1, needle_len - 2) == 0)
+                return p + bit;
+            mask &= mask - 1;
+        }
+    }
+
+    for (; i + needle_len - 1 + 32 <= haystack_len; i += 32)
+    {
+        __m256i block_first = _mm256_loadu_si256((const __m256i *)(haystack + i));
+        __m256i block_last = _mm256_loadu_si256((const __m256i *)(haystack + i + needle_len - 1));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(first, block_first), _mm256_cmpeq_epi8(last, block_last)));
+
+        while (mask)
+        {
+            int bit = __builtin_ctz(mask);
+            if (needle_len <= 2 || memcmp(haystack + i + bit + 1, needle + 1, needle_len - 2) == 0)
+                return haystack + i + bit;
+            mask &= mask - 1;
+        }
+    }
+
+    return scan_find_sse2(haystack + i, haystack_len - i, needle, needle_len);
+}
+
+#endif // SCANNER_X86
+
+// Seleccionar la mejor implementación soportada por la CPU
+static void scanner_detect(void)
+{
+    active_scan = scan_find_scalar;
+    active_impl = SCANNER_IMPL_SCALAR;
+
+#ifdef SCANNER_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        active_scan = scan_find_avx2;
+        active_impl = SCANNER_IMPL_AVX2;
+    }
+    else if (__builtin_cpu_supports("sse2"))
+    {
+        active_scan = scan_find_sse2;
+        active_impl = SCANNER_IMPL_SSE2;
+    }
+#endif
+}
+
+const char *scan_find(const char *haystack, size_t haystack_len,
+                      const char *needle, size_t needle_len)
+{
+    pthread_once(&scanner_once, scanner_detect);
+    return active_scan(haystack, haystack_len, needle, needle_len);
+}
+
+const char *scan_find_header_end(const char *data, size_t data_len)
+{
+    return scan_find(data, data_len, "\r\n\r\n", 4);
+}
+
+int scanner_set_implementation(scanner_impl_t impl)
+{
+    pthread_once(&scanner_once, scanner_detect);
+
+    switch (impl)
+    {
+    case SCANNER_IMPL_AUTO:
+        scanner_detect();
+        return 1;
+    case SCANNER_IMPL_SCALAR:
+        active_scan = scan_find_scalar;
+        break;
+#ifdef SCANNER_X86
+    case SCANNER_IMPL_SSE2:
+        if (!__builtin_cpu_supports("sse2"))
+            return 0;
+        active_scan = scan_find_sse2;
+        break;
+    case SCANNER_IMPL_AVX2:
+        if (!__builtin_cpu_supports("avx2"))
+            return 0;
+        active_scan = scan_find_avx2;
+        break;
+#endif
+    default:
+        return 0;
+    }
+
+    active_impl = impl;
+    return 1;
+}
+
+const char *scanner_implementation_name(void)
+{
+    pthread_once(&scanner_once, scanner_detect);
+
+    switch (active_impl)
+    {
+    case SCANNER_IMPL_AVX2:
+        return "avx2";
+    case SCANNER_IMPL_SSE2:
+        return "sse2";
+    default:
+        return "scalar";
+    }
+}
@@ -4,13 +4,19 @@
 #include "server.h"
 #include "file_handler.h"
 #include "priority_queue.h"
+#include "scanner.h"
+#include "buffer_pool.h"
+#include <fcntl.h>
+#include <sched.h>
+#include <stdarg.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
 
 // Variable global del servidor
 tcp_server_t main_server;
 // Estadísticas globales de archivos
 static file_stats_t global_stats = {0};
-// Buffer para recibir datos grandes (para archivos)
-// static char large_buffer[MAX_UPLOAD_SIZE];
 
 // Función auxiliar para strcasestr en sistemas que no la tienen
 #ifndef strcasestr
@@ -41,6 +47,68 @@ file_stats_t *get_file_stats(void)
 {
     return &global_stats;
 }
+// Buscar conexión por descriptor
+static client_info_t *lookup_client(int socket_fd)
+{
+    client_info_t *client = NULL;
+
+    pthread_mutex_lock(&main_server.clients_mutex);
+    if (main_server.clients && socket_fd >= 0 && socket_fd < main_server.max_fds)
+    {
+        client = main_server.clients[socket_fd];
+    }
+    pthread_mutex_unlock(&main_server.clients_mutex);
+
+    return client;
+}
+
+// Despertar un reactor a través de su eventfd
+static void wake_reactor(reactor_t *reactor)
+{
+    uint64_t one = 1;
+    if (write(reactor->event_fd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+    {
+        LOG_DEBUG("Error notificando reactor %d: %s", reactor->id, strerror(errno));
+    }
+}
+
+// Crear socket de escucha no bloqueante enlazado al puerto configurado
+static int create_listen_socket(int reuseport)
+{
+    int listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd == -1)
+    {
+        LOG_ERROR("Error creando socket: %s", strerror(errno));
+        return -1;
+    }
+
+    // Configurar opción SO_REUSEADDR
+    int opt = 1;
+    if (setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0)
+    {
+        LOG_WARNING("Error configurando SO_REUSEADDR: %s", strerror(errno));
+    }
+
+    // Varios sockets en el mismo puerto: el kernel reparte las conexiones
+    if (reuseport && setsockopt(listen_fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0)
+    {
+        LOG_ERROR("Error configurando SO_REUSEPORT: %s", strerror(errno));
+        close(listen_fd);
+        return -1;
+    }
+
+    // Bind del socket
+    if (bind(listen_fd, (struct sockaddr *)&main_server.server_addr,
+             sizeof(main_server.server_addr)) < 0)
+    {
+        LOG_ERROR("Error en bind puerto %d: %s", server_config.port, strerror(errno));
+        close(listen_fd);
+        return -1;
+    }
+
+    return listen_fd;
+}
+
 // Inicializar el servidor
 int init_server(void)
 {
@@ -59,42 +127,34 @@ int init_server(void)
         return 0;
     }
 
-    // Inicializar cola de prioridad
-    if (!init_priority_queue())
+    // Tabla de conexiones indexada por descriptor
+    struct rlimit fd_limit;
+    main_server.max_fds = 65536;
+    if (getrlimit(RLIMIT_NOFILE, &fd_limit) == 0 && fd_limit.rlim_cur != RLIM_INFINITY &&
+        fd_limit.rlim_cur < (rlim_t)main_server.max_fds)
     {
-        LOG_ERROR("Error inicializando cola de prioridad");
-        pthread_mutex_destroy(&main_server.clients_mutex);
-        return 0;
+        main_server.max_fds = (int)fd_limit.rlim_cur;
     }
 
-    // Inicializar estadísticas de archivos
-    init_file_stats();
-
-    // Crear socket del servidor
-    main_server.server_socket = socket(AF_INET, SOCK_STREAM, 0);
-    if (main_server.server_socket == -1)
+    main_server.clients = calloc(main_server.max_fds, sizeof(client_info_t *));
+    if (!main_server.clients)
     {
-        LOG_ERROR("Error creando socket: %s", strerror(errno));
-        destroy_priority_queue();
+        LOG_ERROR("Error allocando tabla de conexiones (%d descriptores)", main_server.max_fds);
         pthread_mutex_destroy(&main_server.clients_mutex);
         return 0;
     }
 
-    // Configurar opción SO_REUSEADDR
-    int opt = 1;
-    if (setsockopt(main_server.server_socket, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0)
+    // Inicializar cola de prioridad
+    if (!init_priority_queue())
     {
-        LOG_WARNING("Error configurando SO_REUSEADDR: %s", strerror(errno));
+        LOG_ERROR("Error inicializando cola de prioridad");
+        free(main_server.clients);
+        pthread_mutex_destroy(&main_server.clients_mutex);
+        return 0;
     }
 
-    // Configurar timeout para recv (30 segundos)
-    struct timeval timeout;
-    timeout.tv_sec = 30;
-    timeout.tv_usec = 0;
-    if (setsockopt(main_server.server_socket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) < 0)
-    {
-        LOG_WARNING("Error configurando timeout de recepción: %s", strerror(errno));
-    }
+    // Inicializar estadísticas de archivos
+    init_file_stats();
 
     // Configurar direccion del servidor
     memset(&main_server.server_addr, 0, sizeof(main_server.server_addr));
@@ -102,35 +162,67 @@ int init_server(void)
     main_server.server_addr.sin_addr.s_addr = INADDR_ANY;
     main_server.server_addr.sin_port = htons(server_config.port);
 
-    // Bind del socket
-    if (bind(main_server.server_socket, (struct sockaddr *)&main_server.server_addr,
-             sizeof(main_server.server_addr)) < 0)
+    // Crear socket del servidor
+    main_server.sharded_listeners = server_config.reuseport_listeners ? 1 : 0;
+    main_server.server_socket = create_listen_socket(main_server.sharded_listeners);
+    if (main_server.server_socket == -1)
     {
-        LOG_ERROR("Error en bind puerto %d: %s", server_config.port, strerror(errno));
-        close(main_server.server_socket);
         destroy_priority_queue();
+        free(main_server.clients);
         pthread_mutex_destroy(&main_server.clients_mutex);
         return 0;
     }
 
-    // Inicializar cola de prioridad
-    if (!init_priority_queue())
+    // Crear reactores (epoll + eventfd por hilo)
+    main_server.reactor_count = server_config.reactor_threads;
+    if (main_server.reactor_count < 1)
+        main_server.reactor_count = 1;
+    if (main_server.reactor_count > MAX_REACTORS)
+        main_server.reactor_count = MAX_REACTORS;
+
+    for (int i = 0; i < main_server.reactor_count; i++)
     {
-        LOG_ERROR("Error inicializando cola de prioridad");
-        close(main_server.server_socket);
-        return 0;
+        reactor_t *reactor = &main_server.reactors[i];
+        reactor->id = i;
+        reactor->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        reactor->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        pthread_mutex_init(&reactor->completed_mutex, NULL);
+
+        // En modo SO_REUSEPORT cada reactor tiene su propio socket de escucha
+        if (i == 0)
+            reactor->listen_fd = main_server.server_socket;
+        else if (main_server.sharded_listeners)
+            reactor->listen_fd = create_listen_socket(1);
+        else
+            reactor->listen_fd = -1;
+
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN | EPOLLET;
+        ev.data.ptr = &reactor->event_fd;
+
+        if (reactor->epoll_fd < 0 || reactor->event_fd < 0 ||
+            (main_server.sharded_listeners && reactor->listen_fd < 0) ||
+            epoll_ctl(reactor->epoll_fd, EPOLL_CTL_ADD, reactor->event_fd, &ev) < 0)
+        {
+            LOG_ERROR("Error creando reactor %d: %s", i, strerror(errno));
+            main_server.reactor_count = i + 1;
+            cleanup_server();
+            return 0;
+        }
     }
 
     // Iniciar procesador de archivos
     if (!start_file_processor())
     {
         LOG_ERROR("Error iniciando procesador de archivos");
-        destroy_priority_queue();
-        close(main_server.server_socket);
+        cleanup_server();
         return 0;
     }
 
-    LOG_INFO("Servidor inicializado correctamente en puerto %d", server_config.port);
+    LOG_INFO("Servidor inicializado correctamente en puerto %d (%d reactores, %s)",
+             server_config.port, main_server.reactor_count,
+             main_server.sharded_listeners ? "SO_REUSEPORT por reactor" : "socket de escucha único");
     return 1;
 }
 
@@ -146,12 +238,30 @@ int start_server(void)
     main_server.status = SERVER_STARTING;
     LOG_INFO("Iniciando servidor TCP...");
 
-    // Poner socket en modo escucha
-    if (listen(main_server.server_socket, server_config.max_connections) < 0)
+    // Poner sockets en modo escucha y registrarlos en su reactor
+    for (int i = 0; i < main_server.reactor_count; i++)
     {
-        LOG_ERROR("Error en listen: %s", strerror(errno));
-        main_server.status = SERVER_STOPPED;
-        return 0;
+        reactor_t *reactor = &main_server.reactors[i];
+        if (reactor->listen_fd < 0)
+            continue;
+
+        if (listen(reactor->listen_fd, server_config.max_connections) < 0)
+        {
+            LOG_ERROR("Error en listen: %s", strerror(errno));
+            main_server.status = SERVER_STOPPED;
+            return 0;
+        }
+
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN | EPOLLET;
+        ev.data.ptr = &reactor->listen_fd;
+        if (epoll_ctl(reactor->epoll_fd, EPOLL_CTL_ADD, reactor->listen_fd, &ev) < 0)
+        {
+            LOG_ERROR("Error registrando socket de escucha en epoll: %s", strerror(errno));
+            main_server.status = SERVER_STOPPED;
+            return 0;
+        }
     }
 
     // Iniciar procesador de archivos
@@ -162,339 +272,730 @@ int start_server(void)
         return 0;
     }
 
-    // Crear hilo del servidor
-    if (pthread_create(&main_server.server_thread, NULL, server_thread_func, NULL) != 0)
+    // Crear hilos de los reactores
+    main_server.status = SERVER_RUNNING;
+    for (int i = 0; i < main_server.reactor_count; i++)
     {
-        LOG_ERROR("Error creando hilo del servidor: %s", strerror(errno));
-        main_server.status = SERVER_STOPPED;
-        return 0;
+        if (pthread_create(&main_server.reactors[i].thread, NULL, reactor_thread_func,
+                           &main_server.reactors[i]) != 0)
+        {
+            LOG_ERROR("Error creando hilo del reactor %d: %s", i, strerror(errno));
+            main_server.status = SERVER_STOPPING;
+            for (int j = 0; j < i; j++)
+            {
+                wake_reactor(&main_server.reactors[j]);
+                pthread_join(main_server.reactors[j].thread, NULL);
+            }
+            main_server.status = SERVER_STOPPED;
+            return 0;
+        }
     }
 
-    main_server.status = SERVER_RUNNING;
     LOG_INFO("Servidor TCP iniciado - Escuchando en puerto %d", server_config.port);
     LOG_INFO("Máximo de conexiones: %d", server_config.max_connections);
+    LOG_INFO("Búsqueda de delimitadores: %s", scanner_implementation_name());
 
     return 1;
 }
 
-// Hilo principal del servidor
-void *server_thread_func(void *arg)
+// Hilo de un reactor: atiende todos los eventos de sus conexiones
+void *reactor_thread_func(void *arg)
 {
-    (void)arg; // Evitar warning de parámetro no usado
+    reactor_t *reactor = (reactor_t *)arg;
+    struct epoll_event events[MAX_EPOLL_EVENTS];
+    time_t last_sweep = time(NULL);
 
-    LOG_INFO("Hilo del servidor iniciado");
+    // Con listeners compartidos, fijar cada reactor a un núcleo
+    if (main_server.sharded_listeners)
+    {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        if (cpus > 0)
+        {
+            cpu_set_t cpu_set;
+            CPU_ZERO(&cpu_set);
+            CPU_SET(reactor->id % cpus, &cpu_set);
+            if (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set) != 0)
+            {
+                LOG_WARNING("No se pudo fijar el reactor %d al núcleo %ld", reactor->id, reactor->id % cpus);
+            }
+        }
+    }
+
+    LOG_INFO("Reactor %d iniciado", reactor->id);
 
     while (main_server.status == SERVER_RUNNING)
     {
-        // Aceptar nueva conexión
-        if (accept_client_connection() < 0)
+        int ready = epoll_wait(reactor->epoll_fd, events, MAX_EPOLL_EVENTS, 1000);
+        if (ready < 0)
         {
-            if (main_server.status == SERVER_RUNNING)
+            if (errno != EINTR)
             {
-                LOG_ERROR("Error aceptando conexión");
+                LOG_ERROR("Error en epoll_wait (reactor %d): %s", reactor->id, strerror(errno));
                 usleep(100000); // Esperar 100ms antes de intentar de nuevo
             }
+            continue;
+        }
+
+        for (int i = 0; i < ready; i++)
+        {
+            void *tag = events[i].data.ptr;
+
+            if (tag == &reactor->listen_fd)
+            {
+                accept_client_connection(reactor);
+                continue;
+            }
+
+            if (tag == &reactor->event_fd)
+            {
+                uint64_t value;
+                while (read(reactor->event_fd, &value, sizeof(value)) > 0)
+                    ;
+                continue;
+            }
+
+            handle_client_event((client_info_t *)tag, events[i].events);
         }
 
+        // Respuestas terminadas por el procesador de archivos
+        process_completed_connections(reactor);
+
         // Limpiar clientes inactivos periódicamente
-        cleanup_inactive_clients();
+        time_t now = time(NULL);
+        if (now != last_sweep)
+        {
+            cleanup_inactive_clients(reactor);
+            last_sweep = now;
+        }
 
         // Limpiar archivos temporales antiguos cada cierto tiempo
-        static time_t last_cleanup = 0;
-        time_t now = time(NULL);
-        if (now - last_cleanup > 3600)
-        {                                             // Cada hora
-            int cleaned = cleanup_old_temp_files(24); // Limpiar archivos > 24h
-            if (cleaned > 0)
-            {
-                LOG_INFO("Limpiados %d archivos temporales antiguos", cleaned);
+        if (reactor->id == 0)
+        {
+            static time_t last_cleanup = 0;
+            if (now - last_cleanup > 3600)
+            {                                             // Cada hora
+                int cleaned = cleanup_old_temp_files(24); // Limpiar archivos > 24h
+                if (cleaned > 0)
+                {
+                    LOG_INFO("Limpiados %d archivos temporales antiguos", cleaned);
+                }
+                last_cleanup = now;
             }
-            last_cleanup = now;
         }
     }
 
-    LOG_INFO("Hilo del servidor terminando...");
+    LOG_INFO("Reactor %d terminando...", reactor->id);
     return NULL;
 }
 
-// Aceptar conexión de cliente
-int accept_client_connection(void)
+// Aceptar todas las conexiones pendientes (socket de escucha edge-triggered)
+int accept_client_connection(reactor_t *reactor)
 {
-    struct sockaddr_in client_addr;
-    socklen_t client_len = sizeof(client_addr);
-    int client_socket;
+    int accepted = 0;
 
-    // Aceptar conexión
-    client_socket = accept(main_server.server_socket, (struct sockaddr *)&client_addr, &client_len);
-    if (client_socket < 0)
+    while (1)
     {
-        if (errno != EINTR && main_server.status == SERVER_RUNNING)
+        struct sockaddr_in client_addr;
+        socklen_t client_len = sizeof(client_addr);
+
+        int client_socket = accept4(reactor->listen_fd, (struct sockaddr *)&client_addr,
+                                    &client_len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (client_socket < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK && main_server.status == SERVER_RUNNING)
+            {
+                LOG_ERROR("Error en accept (reactor %d): %s", reactor->id, strerror(errno));
+                return -1;
+            }
+            break;
+        }
+
+        // Verificar límite de conexiones
+        pthread_mutex_lock(&main_server.clients_mutex);
+        int client_count = main_server.client_count;
+        pthread_mutex_unlock(&main_server.clients_mutex);
+
+        if (client_count >= server_config.max_connections || client_socket >= main_server.max_fds)
+        {
+            LOG_WARNING("Máximo de conexiones alcanzado, rechazando cliente");
+
+            // Enviar respuesta de servidor ocupado
+            const char *busy = "HTTP/1.1 503 Service Unavailable\r\n"
+                               "Content-Type: application/json\r\n"
+                               "Content-Length: 34\r\n"
+                               "Connection: close\r\n"
+                               "\r\n"
+                               "{\"error\":\"Server busy\",\"code\":503}";
+            if (send(client_socket, busy, strlen(busy), MSG_NOSIGNAL) < 0)
+            {
+                LOG_DEBUG("Error enviando 503: %s", strerror(errno));
+            }
+            close(client_socket);
+            continue;
+        }
+
+        // Agregar cliente: se queda en este reactor si el listener es propio
+        if (add_client(client_socket, &client_addr,
+                       main_server.sharded_listeners ? reactor : NULL) < 0)
         {
-            LOG_ERROR("Error en accept: %s", strerror(errno));
+            LOG_ERROR("Error agregando cliente");
+            close(client_socket);
+            continue;
         }
+
+        accepted++;
+    }
+
+    return accepted;
+}
+
+// Agregar cliente a la tabla y asignarlo a un reactor (round-robin si no se indica)
+int add_client(int socket_fd, struct sockaddr_in *client_addr, reactor_t *reactor)
+{
+    client_info_t *client = calloc(1, sizeof(client_info_t));
+    if (!client)
+    {
         return -1;
     }
 
-    // Verificar límite de conexiones
+    // Configurar información del cliente
+    client->socket_fd = socket_fd;
+    client->address = *client_addr;
+    client->state = CONN_READING_HEADERS;
+    client->connection_time = time(NULL);
+    client->last_activity = client->connection_time;
+    client->spool_fd = -1;
+    client->pipe_fds[0] = -1;
+    client->pipe_fds[1] = -1;
+    arena_init(&client->arena);
+
+    // Convertir IP a string
+    inet_ntop(AF_INET, &client_addr->sin_addr, client->ip_str, INET_ADDRSTRLEN);
+
     pthread_mutex_lock(&main_server.clients_mutex);
-    if (main_server.client_count >= server_config.max_connections)
+    if (!reactor)
     {
-        pthread_mutex_unlock(&main_server.clients_mutex);
-        LOG_WARNING("Máximo de conexiones alcanzado, rechazando cliente");
-
-        // Enviar respuesta de servidor ocupado
-        send_http_response(client_socket, 503, "application/json",
-                           "{\"error\":\"Server busy\",\"code\":503}", 31);
-        close(client_socket);
-        return -1;
+        reactor = &main_server.reactors[main_server.next_reactor];
+        main_server.next_reactor = (main_server.next_reactor + 1) % main_server.reactor_count;
     }
+    client->reactor_id = reactor->id;
+    main_server.clients[socket_fd] = client;
+    main_server.client_count++;
+    int total = main_server.client_count;
     pthread_mutex_unlock(&main_server.clients_mutex);
 
-    // Agregar cliente y crear hilo
-    int client_index = add_client(client_socket, &client_addr);
-    if (client_index < 0)
+    // Insertar en la lista del reactor antes de registrar en epoll
+    pthread_mutex_lock(&reactor->completed_mutex);
+    client->next = reactor->connections;
+    if (reactor->connections)
+        reactor->connections->prev = client;
+    reactor->connections = client;
+    reactor->connection_count++;
+    pthread_mutex_unlock(&reactor->completed_mutex);
+
+    LOG_INFO("Cliente conectado: %s (Total: %d, reactor %d)", client->ip_str, total, reactor->id);
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    ev.data.ptr = client;
+    if (epoll_ctl(reactor->epoll_fd, EPOLL_CTL_ADD, socket_fd, &ev) < 0)
     {
-        LOG_ERROR("Error agregando cliente");
-        close(client_socket);
-        return -1;
+        LOG_ERROR("Error registrando cliente en epoll: %s", strerror(errno));
+        close_client_connection(client);
+        return -2;
     }
 
-    return 0;
+    return socket_fd;
 }
 
-// Agregar cliente a la lista
-int add_client(int socket_fd, struct sockaddr_in *client_addr)
+// Cerrar el pipe de un upload raw
+static void close_raw_upload_pipe(client_info_t *client)
 {
-    pthread_mutex_lock(&main_server.clients_mutex);
-
-    // Buscar slot libre
-    int client_index = -1;
-    for (int i = 0; i < MAX_CLIENTS; i++)
+    for (int i = 0; i < 2; i++)
     {
-        if (!main_server.clients[i].active)
+        if (client->pipe_fds[i] >= 0)
         {
-            client_index = i;
-            break;
+            close(client->pipe_fds[i]);
+            client->pipe_fds[i] = -1;
         }
     }
+}
 
-    if (client_index == -1)
-    {
-        pthread_mutex_unlock(&main_server.clients_mutex);
-        return -1;
-    }
-
-    // Configurar información del cliente
-    main_server.clients[client_index].socket_fd = socket_fd;
-    main_server.clients[client_index].address = *client_addr;
-    main_server.clients[client_index].active = 1;
-    main_server.clients[client_index].connection_time = time(NULL);
-
-    // Convertir IP a string
-    inet_ntop(AF_INET, &client_addr->sin_addr,
-              main_server.clients[client_index].ip_str, INET_ADDRSTRLEN);
+// Cerrar conexión y liberar su estado
+void close_client_connection(client_info_t *client)
+{
+    reactor_t *reactor = &main_server.reactors[client->reactor_id];
 
-    main_server.client_count++;
+    pthread_mutex_lock(&reactor->completed_mutex);
+    if (client->prev)
+        client->prev->next = client->next;
+    else
+        reactor->connections = client->next;
+    if (client->next)
+        client->next->prev = client->prev;
+    reactor->connection_count--;
+    pthread_mutex_unlock(&reactor->completed_mutex);
 
-    LOG_INFO("Cliente conectado: %s (Total: %d)",
-             main_server.clients[client_index].ip_str, main_server.client_count);
+    pthread_mutex_lock(&main_server.clients_mutex);
+    main_server.clients[client->socket_fd] = NULL;
+    main_server.client_count--;
+    int total = main_server.client_count;
+    pthread_mutex_unlock(&main_server.clients_mutex);
 
-    // Crear hilo para el cliente
-    if (pthread_create(&main_server.clients[client_index].thread_id, NULL,
-                       client_handler_thread, &main_server.clients[client_index]) != 0)
+    // Cerrar socket de forma limpia
+    if (shutdown(client->socket_fd, SHUT_RDWR) < 0)
     {
-        LOG_ERROR("Error creando hilo para cliente: %s", strerror(errno));
-        main_server.clients[client_index].active = 0;
-        main_server.client_count--;
-        pthread_mutex_unlock(&main_server.clients_mutex);
-        return -1;
+        LOG_DEBUG("Error en shutdown del socket: %s", strerror(errno));
     }
+    close(client->socket_fd);
 
-    pthread_mutex_unlock(&main_server.clients_mutex);
-    return client_index;
+    LOG_INFO("Cliente desconectado: %s (Total: %d)", client->ip_str, total);
+
+    close_raw_upload_pipe(client);
+    if (client->spool_fd >= 0)
+        close(client->spool_fd);
+    arena_release(&client->arena);
+    free(client);
 }
 
-// Recibir petición HTTP completa con soporte para archivos grandes
-int receive_complete_request(int client_socket, char *buffer, size_t buffer_size, size_t *total_received)
+// Enviar la respuesta pendiente; cierra la conexión al terminar
+static void write_client_response(client_info_t *client)
 {
-    *total_received = 0;
-    size_t content_length = 0;
-    size_t headers_end_pos = 0;
-    int headers_complete = 0;
+    client->state = CONN_WRITING_RESPONSE;
+    client->last_activity = time(NULL);
 
-    // Configurar timeout para el socket
-    struct timeval timeout;
-    timeout.tv_sec = 30; // 30 segundos timeout
-    timeout.tv_usec = 0;
+    if (client->peer_closed && client->response_sent == 0 && !client->response)
+    {
+        close_client_connection(client);
+        return;
+    }
 
-    if (setsockopt(client_socket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) < 0)
+    while (client->response && client->response_sent < client->response_len)
     {
-        LOG_ERROR("Error configurando timeout del socket: %s", strerror(errno));
+        ssize_t sent = send(client->socket_fd, client->response + client->response_sent,
+                            client->response_len - client->response_sent, MSG_NOSIGNAL);
+        if (sent < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return; // Esperar EPOLLOUT
+            LOG_DEBUG("Error enviando respuesta a %s: %s", client->ip_str, strerror(errno));
+            break;
+        }
+        client->response_sent += sent;
     }
 
-    while (*total_received < buffer_size - 1)
+    close_client_connection(client);
+}
+
+// Recibir headers en el buffer fijo de la conexión
+// Retorna 1 si los headers están completos, 0 si faltan datos, -1 si la conexión se cerró
+static int read_client_headers(client_info_t *client)
+{
+    while (client->header_received < MAX_BUFFER_SIZE)
     {
-        ssize_t bytes_received = recv(client_socket, buffer + *total_received,
-                                      buffer_size - *total_received - 1, 0);
+        ssize_t bytes_received = recv(client->socket_fd, client->headers + client->header_received,
+                                      MAX_BUFFER_SIZE - client->header_received, 0);
 
-        if (bytes_received <= 0)
+        if (bytes_received < 0)
         {
-            if (bytes_received == 0)
-            {
-                LOG_DEBUG("Cliente cerró la conexión");
-                break;
-            }
-            else if (errno == EAGAIN || errno == EWOULDBLOCK)
-            {
-                LOG_WARNING("Timeout recibiendo datos del cliente");
-                break;
-            }
-            else
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return 0; // Esperar más datos
+            LOG_ERROR("Error recibiendo datos: %s", strerror(errno));
+            close_client_connection(client);
+            return -1;
+        }
+
+        if (bytes_received == 0)
+        {
+            LOG_DEBUG("Cliente cerró la conexión");
+            client->peer_closed = 1;
+            if (client->header_received == 0)
             {
-                LOG_ERROR("Error recibiendo datos: %s", strerror(errno));
+                close_client_connection(client);
                 return -1;
             }
+            send_error_response(client->socket_fd, 400, "Incomplete request");
+            write_client_response(client);
+            return -1;
         }
 
-        *total_received += bytes_received;
-        buffer[*total_received] = '\0';
+        // Solo revisar los bytes nuevos más los 3 anteriores (separador partido entre lecturas)
+        size_t scan_from = client->header_received >= 3 ? client->header_received - 3 : 0;
+        client->header_received += bytes_received;
+        client->headers[client->header_received] = '\0';
+        client->last_activity = time(NULL);
 
         // Verificar si hemos recibido los headers completos
-        if (!headers_complete)
+        const char *headers_end = scan_find_header_end(client->headers + scan_from,
+                                                       client->header_received - scan_from);
+        if (headers_end)
         {
-            char *headers_end = strstr(buffer, "\r\n\r\n");
-            if (headers_end)
-            {
-                headers_end_pos = headers_end - buffer + 4;
-                headers_complete = 1;
-
-                // Buscar Content-Length en los headers
-                char *content_length_header = strcasestr(buffer, "content-length:");
-                if (content_length_header)
-                {
-                    content_length = strtoul(content_length_header + 15, NULL, 10);
-                    LOG_DEBUG("Content-Length detectado: %zu", content_length);
-
-                    // Verificar límite de tamaño
-                    if (content_length > MAX_UPLOAD_SIZE)
-                    {
-                        LOG_ERROR("Content-Length demasiado grande: %zu bytes (máximo: %d)",
-                                  content_length, MAX_UPLOAD_SIZE);
-                        return -1;
-                    }
-                }
-            }
+            client->headers_len = headers_end - client->headers + 4;
+            return 1;
         }
+    }
 
-        // Si hemos recibido los headers y conocemos el Content-Length
-        if (headers_complete && content_length > 0)
+    LOG_WARNING("Headers demasiado grandes desde %s (máximo: %d bytes)", client->ip_str, MAX_BUFFER_SIZE);
+    send_error_response(client->socket_fd, 400, "Request headers too large");
+    write_client_response(client);
+    return -1;
+}
+
+// Verificar si el media type del header Content-Type es application/octet-stream
+// (sin distinguir mayúsculas; se ignoran los parámetros después de ';')
+static int is_octet_stream_content_type(const char *headers)
+{
+    static const char octet_stream[] = "application/octet-stream";
+    const char *line = headers;
+
+    while ((line = strchr(line, '\n')) != NULL)
+    {
+        line++;
+        if (strncasecmp(line, "content-type:", 13) != 0)
         {
-            size_t expected_total = headers_end_pos + content_length;
+            continue;
+        }
 
-            if (*total_received >= expected_total)
+        const char *value = line + 13;
+        value += strspn(value, " \t");
+        size_t value_len = strcspn(value, "; \t\r\n");
+        return value_len == sizeof(octet_stream) - 1 &&
+               strncasecmp(value, octet_stream, value_len) == 0;
+    }
+    return 0;
+}
+
+// Preparar un upload raw: spool anónimo, pipe para splice y los bytes del body
+// que llegaron junto con los headers (esos sí se escriben desde user space)
+// Retorna 0 si se puede continuar, -1 si la petición fue rechazada
+static int prepare_raw_upload(client_info_t *client, char first_body_byte)
+{
+    size_t max_size = (size_t)server_config.max_image_size_mb * 1024 * 1024;
+    if (client->content_length > max_size)
+    {
+        LOG_ERROR("Upload raw demasiado grande: %zu bytes (máximo: %d MB)", client->content_length,
+                  server_config.max_image_size_mb);
+        send_error_response(client->socket_fd, 413, "File too large");
+        write_client_response(client);
+        return -1;
+    }
+
+    client->spool_fd = open_upload_spool();
+    if (client->spool_fd < 0 || pipe2(client->pipe_fds, O_NONBLOCK | O_CLOEXEC) != 0)
+    {
+        LOG_ERROR("No se pudo preparar el spool del upload raw de %s: %s", client->ip_str, strerror(errno));
+        send_error_response(client->socket_fd, 500, "Temporary storage unavailable");
+        write_client_response(client);
+        return -1;
+    }
+    client->is_raw_upload = 1;
+
+    // Un pipe más grande mueve más páginas por llamada (si el límite del sistema lo permite)
+    fcntl(client->pipe_fds[1], F_SETPIPE_SZ, RAW_UPLOAD_PIPE_SIZE);
+
+    size_t extra = client->header_received - client->headers_len;
+    if (extra > client->content_length)
+        extra = client->content_length;
+    if (extra > 0)
+    {
+        client->headers[client->headers_len] = first_body_byte;
+        const char *data = client->headers + client->headers_len;
+        size_t written = 0;
+        while (written < extra)
+        {
+            ssize_t n = write(client->spool_fd, data + written, extra - written);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
             {
-                LOG_DEBUG("Petición completa recibida: %zu bytes (headers: %zu, body: %zu)",
-                          *total_received, headers_end_pos, content_length);
-                break;
+                LOG_ERROR("Error escribiendo spool del upload raw: %s", strerror(errno));
+                send_error_response(client->socket_fd, 500, "Failed to write temporary file");
+                write_client_response(client);
+                return -1;
             }
+            written += (size_t)n;
+        }
+        client->headers[client->headers_len] = '\0';
+    }
+    client->body_received = extra;
 
-            // Verificar si el buffer es suficiente
-            if (expected_total >= buffer_size)
+    return 0;
+}
+
+// Mover el body de un upload raw del socket al spool: socket -> pipe -> spool
+// con splice, las páginas no pasan por user space
+// Retorna 1 si el body está completo, 0 si faltan datos, -1 si la conexión se cerró
+static int splice_client_body(client_info_t *client)
+{
+    while (client->body_received < client->content_length || client->pipe_bytes > 0)
+    {
+        // Vaciar primero lo que quedó en el pipe
+        while (client->pipe_bytes > 0)
+        {
+            ssize_t moved = splice(client->pipe_fds[0], NULL, client->spool_fd, NULL, client->pipe_bytes,
+                                   SPLICE_F_MOVE);
+            if (moved < 0 && errno == EINTR)
+                continue;
+            if (moved <= 0)
             {
-                LOG_ERROR("Buffer insuficiente para la petición completa");
+                LOG_ERROR("Error moviendo el upload raw al spool: %s", strerror(errno));
+                send_error_response(client->socket_fd, 500, "Failed to write temporary file");
+                write_client_response(client);
                 return -1;
             }
+            client->pipe_bytes -= (size_t)moved;
         }
 
-        // Si no hay Content-Length y hemos recibido headers, asumir que es el final
-        if (headers_complete && content_length == 0)
-        {
-            LOG_DEBUG("Petición sin body recibida: %zu bytes", *total_received);
+        if (client->body_received >= client->content_length)
             break;
+
+        ssize_t received = splice(client->socket_fd, NULL, client->pipe_fds[1], NULL,
+                                  client->content_length - client->body_received,
+                                  SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if (received < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return 0; // Esperar más datos
+            LOG_ERROR("Error recibiendo upload raw: %s", strerror(errno));
+            close_client_connection(client);
+            return -1;
         }
 
-        // Protección contra buffer overflow
-        if (*total_received >= buffer_size - 1)
+        if (received == 0)
         {
-            LOG_WARNING("Buffer lleno, terminando recepción");
-            break;
+            LOG_WARNING("Cliente cerró la conexión con el body incompleto (%zu de %zu bytes)",
+                        client->body_received, client->content_length);
+            client->peer_closed = 1;
+            send_error_response(client->socket_fd, 400, "Incomplete request body");
+            write_client_response(client);
+            return -1;
         }
+
+        client->body_received += (size_t)received;
+        client->pipe_bytes += (size_t)received;
+        client->last_activity = time(NULL);
     }
 
-    return (*total_received > 0) ? 0 : -1;
+    close_raw_upload_pipe(client);
+    return 1;
 }
 
-void mark_client_inactive(int client_socket)
+// Preparar el body a partir de Content-Length
+// Retorna 0 si se puede continuar, -1 si la petición fue rechazada
+static int prepare_client_body(client_info_t *client)
 {
-    pthread_mutex_lock(&main_server.clients_mutex);
+    // Aislar los headers de los bytes de body que llegaron con ellos
+    char first_body_byte = client->headers[client->headers_len];
+    client->headers[client->headers_len] = '\0';
 
-    for (int i = 0; i < MAX_CLIENTS; i++)
+    // Parsear método y ruta
+    if (parse_http_request(client->headers, client->method, client->path) != 0)
     {
-        if (main_server.clients[i].active &&
-            main_server.clients[i].socket_fd == client_socket)
-        {
+        LOG_ERROR("Error parseando petición HTTP de %s", client->ip_str);
+        send_error_response(client->socket_fd, 400, "Malformed Request");
+        write_client_response(client);
+        return -1;
+    }
 
-            main_server.clients[i].active = 0;
-            main_server.client_count--;
+    // Buscar Content-Length en los headers
+    char *content_length_header = strcasestr(client->headers, "content-length:");
+    if (content_length_header)
+    {
+        client->content_length = strtoul(content_length_header + 15, NULL, 10);
+        LOG_DEBUG("Content-Length detectado: %zu", client->content_length);
+    }
 
-            LOG_INFO("Cliente marcado como inactivo: %s (Total: %d)",
-                     main_server.clients[i].ip_str, main_server.client_count);
-            break;
+    // Verificar límite de tamaño antes de reservar memoria
+    if (client->content_length > MAX_UPLOAD_SIZE)
+    {
+        LOG_ERROR("Content-Length demasiado grande: %zu bytes (máximo: %d)",
+                  client->content_length, MAX_UPLOAD_SIZE);
+        send_error_response(client->socket_fd, 413, "Payload Too Large");
+        write_client_response(client);
+        return -1;
+    }
+
+    client->state = CONN_READING_BODY;
+    if (client->content_length == 0)
+    {
+        return 0;
+    }
+
+    // Uploads raw: el body va directo al spool, sin buffer en user space
+    if (strcasecmp(client->method, "PUT") == 0 ||
+        (strcasecmp(client->method, "POST") == 0 && is_octet_stream_content_type(client->headers)))
+    {
+        return prepare_raw_upload(client, first_body_byte);
+    }
+
+    // Uploads: validar Content-Type antes de recibir el body
+    if (strcasecmp(client->method, "POST") == 0 &&
+        scan_find(client->headers, client->headers_len, "multipart/form-data", 19))
+    {
+        if (begin_file_upload(client->socket_fd, client->headers,
+                              &client->multipart, &client->upload_info) != 0)
+        {
+            write_client_response(client);
+            return -1;
         }
+        client->is_upload = 1;
     }
 
-    pthread_mutex_unlock(&main_server.clients_mutex);
+    // El body se reserva al tamaño exacto declarado (+1 para el terminador)
+    client->body = arena_alloc(&client->arena, client->content_length + 1);
+    if (!client->body)
+    {
+        LOG_ERROR("Error allocando body de %zu bytes para cliente %s",
+                  client->content_length, client->ip_str);
+        send_error_response(client->socket_fd, 500, "Internal Server Error");
+        write_client_response(client);
+        return -1;
+    }
+
+    // Mover al body los bytes que llegaron junto con los headers
+    size_t extra = client->header_received - client->headers_len;
+    if (extra > client->content_length)
+        extra = client->content_length;
+    if (extra > 0)
+    {
+        client->body[0] = first_body_byte;
+        memcpy(client->body + 1, client->headers + client->headers_len + 1, extra - 1);
+    }
+    client->body_received = extra;
+
+    return 0;
 }
 
-// Hilo manejador de cliente
-void *client_handler_thread(void *arg)
+// Recibir el body directamente en su buffer definitivo
+// Retorna 1 si el body está completo, 0 si faltan datos, -1 si la conexión se cerró
+static int read_client_body(client_info_t *client)
 {
-    client_info_t *client = (client_info_t *)arg;
+    if (client->is_raw_upload)
+        return splice_client_body(client);
 
-    if (!client || client->socket_fd <= 0)
+    while (1)
     {
-        LOG_ERROR("Cliente inválido pasado al handler");
-        return NULL;
-    }
+        // Avanzar el parser multipart sobre los bytes nuevos
+        if (client->is_upload &&
+            multipart_parser_feed(&client->multipart, client->body, client->body_received) < 0)
+        {
+            LOG_ERROR("Error parseando datos multipart de %s", client->ip_str);
+            send_error_response(client->socket_fd, 400, "Failed to parse multipart data");
+            write_client_response(client);
+            return -1;
+        }
 
-    char client_ip[INET_ADDRSTRLEN];
-    inet_ntop(AF_INET, &(client->address.sin_addr), client_ip, INET_ADDRSTRLEN);
+        if (client->body_received >= client->content_length)
+            break;
 
-    LOG_INFO("Iniciando manejo de cliente: %s", client_ip);
+        ssize_t bytes_received = recv(client->socket_fd, client->body + client->body_received,
+                                      client->content_length - client->body_received, 0);
 
-    // Buffer para la petición
-    char *request_buffer = malloc(MAX_UPLOAD_SIZE + MAX_BUFFER_SIZE);
-    if (!request_buffer)
+        if (bytes_received < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return 0; // Esperar más datos
+            LOG_ERROR("Error recibiendo datos: %s", strerror(errno));
+            close_client_connection(client);
+            return -1;
+        }
+
+        if (bytes_received == 0)
+        {
+            LOG_WARNING("Cliente cerró la conexión con el body incompleto (%zu de %zu bytes)",
+                        client->body_received, client->content_length);
+            client->peer_closed = 1;
+            send_error_response(client->socket_fd, 400, "Incomplete request body");
+            write_client_response(client);
+            return -1;
+        }
+
+        client->body_received += bytes_received;
+        client->last_activity = time(NULL);
+    }
+
+    if (client->body)
     {
-        LOG_ERROR("Error allocando buffer para cliente %s", client_ip);
-        close(client->socket_fd);
-        mark_client_inactive(client->socket_fd);
-        return NULL;
+        client->body[client->content_length] = '\0';
     }
 
-    size_t total_received = 0;
-    int result = receive_complete_request(client->socket_fd, request_buffer,
-                                          MAX_UPLOAD_SIZE + MAX_BUFFER_SIZE, &total_received);
+    return 1;
+}
 
-    if (result < 0 || total_received == 0)
+// Recibir datos disponibles y avanzar la máquina de estados
+static void read_client_data(client_info_t *client)
+{
+    if (client->state == CONN_READING_HEADERS)
     {
-        LOG_ERROR("Error recibiendo petición de %s", client_ip);
-        send_error_response(client->socket_fd, 400, "Bad Request");
-        goto cleanup;
+        if (read_client_headers(client) <= 0)
+            return;
+
+        if (prepare_client_body(client) < 0)
+            return;
     }
 
-    LOG_DEBUG("Petición recibida de %s: %zu bytes", client_ip, total_received);
+    if (read_client_body(client) <= 0)
+        return;
 
-    // Parsear método y ruta
-    char method[16];
-    char path[512];
+    LOG_DEBUG("Petición completa recibida: %zu bytes (headers: %zu, body: %zu)",
+              client->headers_len + client->content_length, client->headers_len, client->content_length);
 
-    if (parse_http_request(request_buffer, method, path) != 0)
+    // Petición completa: atenderla
+    handle_client_request(client);
+}
+
+// Despachar un evento de epoll según el estado de la conexión
+void handle_client_event(client_info_t *client, uint32_t events)
+{
+    switch (client->state)
     {
-        LOG_ERROR("Error parseando petición HTTP de %s", client_ip);
-        send_error_response(client->socket_fd, 400, "Malformed Request");
-        goto cleanup;
+    case CONN_READING_HEADERS:
+    case CONN_READING_BODY:
+        if (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+        {
+            read_client_data(client);
+        }
+        break;
+
+    case CONN_WAITING_QUEUE:
+        // El procesador es dueño de la conexión; solo recordar el cierre
+        if (events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+        {
+            client->peer_closed = 1;
+        }
+        break;
+
+    case CONN_WRITING_RESPONSE:
+        if (events & (EPOLLHUP | EPOLLERR))
+        {
+            close_client_connection(client);
+        }
+        else if (events & EPOLLOUT)
+        {
+            write_client_response(client);
+        }
+        break;
     }
+}
+
+// Atender una petición HTTP completa
+void handle_client_request(client_info_t *client)
+{
+    const char *client_ip = client->ip_str;
+    const char *method = client->method;
+    const char *path = client->path;
+    size_t total_received = client->headers_len + client->content_length;
 
     LOG_INFO("Petición: %s %s desde %s (%zu bytes)", method, path, client_ip, total_received);
 
@@ -506,25 +1007,52 @@ void *client_handler_thread(void *arg)
             LOG_ERROR("Error procesando GET de %s", client_ip);
         }
     }
+    else if (client->is_raw_upload)
+    {
+        // El body completo ya está en el spool; la cola pasa a ser dueña del fd
+        int spool_fd = client->spool_fd;
+        client->spool_fd = -1;
+        client->state = CONN_WAITING_QUEUE;
+
+        // El nombre sale del último segmento de la ruta, sin query string
+        char filename[MAX_FILENAME_SIZE];
+        const char *last_segment = strrchr(path, '/');
+        strncpy(filename, last_segment ? last_segment + 1 : path, sizeof(filename) - 1);
+        filename[sizeof(filename) - 1] = '\0';
+        filename[strcspn(filename, "?#")] = '\0';
+        if (handle_raw_upload_request(client->socket_fd, spool_fd, client->content_length, filename,
+                                      client_ip) == 0)
+        {
+            // El procesador de archivos enviará la respuesta final
+            return;
+        }
+        LOG_ERROR("Error procesando upload raw de %s", client_ip);
+    }
     else if (strcasecmp(method, "POST") == 0)
     {
         // Verificar que es un upload de archivo
-        if (strstr(request_buffer, "multipart/form-data") != NULL)
+        if (client->is_upload)
         {
             LOG_INFO("Detectado upload de archivo desde %s", client_ip);
 
-            if (handle_file_upload_request(client->socket_fd, request_buffer, total_received, client_ip) == 0)
+            if (multipart_parser_finish(&client->multipart) != FILE_UPLOAD_SUCCESS)
             {
-                // Respuesta JSON indicando éxito
-                const char *resp = "{\"status\":\"success\",\"message\":\"Archivo procesado correctamente\"}";
-                send_http_response(client->socket_fd, 200, "application/json", resp, strlen(resp));
-                log_client_activity(client_ip, path, "POST", "success");
+                LOG_ERROR("Error parseando datos multipart");
+                send_error_response(client->socket_fd, 400, "Failed to parse multipart data");
+                write_client_response(client);
+                return;
             }
-            else
+
+            // La conexión queda en espera del procesador antes de encolar
+            client->state = CONN_WAITING_QUEUE;
+            if (handle_file_upload_request(client->socket_fd, &client->upload_info, client_ip) == 0)
             {
-                LOG_ERROR("Error procesando POST de %s", client_ip);
-                send_error_response(client->socket_fd, 500, "Internal Server Error");
+                // El procesador de archivos enviará la respuesta final
+                return;
             }
+
+            LOG_ERROR("Error procesando POST de %s", client_ip);
+            send_error_response(client->socket_fd, 500, "Internal Server Error");
         }
         else
         {
@@ -532,27 +1060,111 @@ void *client_handler_thread(void *arg)
             send_error_response(client->socket_fd, 400, "Expected multipart/form-data");
         }
     }
+    else if (strcasecmp(method, "PUT") == 0)
+    {
+        LOG_WARNING("PUT sin body desde %s", client_ip);
+        send_error_response(client->socket_fd, 400, "Empty upload");
+    }
     else
     {
         LOG_WARNING("Método HTTP no soportado: %s desde %s", method, client_ip);
         send_error_response(client->socket_fd, 405, "Method Not Allowed");
     }
 
-cleanup:
-    free(request_buffer);
+    write_client_response(client);
+}
 
-    // Cerrar socket de forma limpia
-    if (shutdown(client->socket_fd, SHUT_RDWR) < 0)
+// Devolver una conexión encolada a su reactor
+void release_client_connection(int client_socket)
+{
+    client_info_t *client = lookup_client(client_socket);
+    if (!client)
     {
-        LOG_DEBUG("Error en shutdown del socket: %s", strerror(errno));
+        LOG_WARNING("Conexión desconocida al liberar socket %d", client_socket);
+        return;
     }
 
-    close(client->socket_fd);
-    mark_client_inactive(client->socket_fd);
+    reactor_t *reactor = &main_server.reactors[client->reactor_id];
 
-    LOG_INFO("Cliente desconectado: %s", client_ip);
+    pthread_mutex_lock(&reactor->completed_mutex);
+    client->next_completed = reactor->completed;
+    reactor->completed = client;
+    pthread_mutex_unlock(&reactor->completed_mutex);
 
-    return NULL;
+    wake_reactor(reactor);
+}
+
+// Liberar el body de un upload ya guardado en disco
+void release_client_body(int client_socket)
+{
+    client_info_t *client = lookup_client(client_socket);
+    if (!client || client->response)
+        return;
+
+    arena_reset(&client->arena);
+    client->body = NULL;
+    client->upload_info.file_data = NULL;
+}
+
+// Enviar las respuestas que el procesador dejó listas
+void process_completed_connections(reactor_t *reactor)
+{
+    pthread_mutex_lock(&reactor->completed_mutex);
+    client_info_t *completed = reactor->completed;
+    reactor->completed = NULL;
+    pthread_mutex_unlock(&reactor->completed_mutex);
+
+    while (completed)
+    {
+        client_info_t *next = completed->next_completed;
+        completed->next_completed = NULL;
+        write_client_response(completed);
+        completed = next;
+    }
+}
+
+// Copiar un nombre de archivo como string JSON: escapa comillas y barras,
+// y reemplaza caracteres de control por '?'
+static void json_escape_string(const char *src, char *dst, size_t dst_size)
+{
+    size_t out = 0;
+    for (; *src && out + 2 < dst_size; src++)
+    {
+        unsigned char c = (unsigned char)*src;
+        if (c == '"' || c == '\\')
+        {
+            dst[out++] = '\\';
+            dst[out++] = (char)c;
+        }
+        else
+        {
+            dst[out++] = c < 0x20 ? '?' : (char)c;
+        }
+    }
+    dst[out] = '\0';
+}
+
+// Agregar texto con formato al final de un buffer JSON. Si no entra, *len
+// queda en el tamaño del buffer (las llamadas siguientes no escriben nada)
+// Retorna 1 si el texto entró completo, 0 si se truncó
+__attribute__((format(printf, 4, 5)))
+static int append_json(char *buffer, size_t size, size_t *len, const char *fmt, ...)
+{
+    if (*len >= size)
+        return 0;
+
+    va_list args;
+    va_start(args, fmt);
+    int written = vsnprintf(buffer + *len, size - *len, fmt, args);
+    va_end(args);
+
+    if (written < 0 || (size_t)written >= size - *len)
+    {
+        *len = size;
+        return 0;
+    }
+    *len += (size_t)written;
+    return 1;
 }
 
 // Manejar petición GET
@@ -561,8 +1173,12 @@ int handle_get_request(int client_socket, const char *path, const char *client_i
     if (strcmp(path, "/") == 0 || strcmp(path, "/status") == 0)
     {
         // Página de status del servidor
-        char response_body[1024];
+        char response_body[2048];
         const file_stats_t *stats = get_file_stats();
+        buffer_pool_stats_t pool_stats;
+        buffer_pool_get_stats(&pool_stats);
+        arena_stats_t arena_stats;
+        arena_get_stats(&arena_stats);
 
         snprintf(response_body, sizeof(response_body),
                  "{\n"
@@ -572,10 +1188,29 @@ int handle_get_request(int client_socket, const char *path, const char *client_i
                  "  \"port\": %d,\n"
                  "  \"active_connections\": %d,\n"
                  "  \"max_connections\": %d,\n"
+                 "  \"reactor_threads\": %d,\n"
+                 "  \"reuseport_listeners\": %s,\n"
                  "  \"processing_queue\": {\n"
                  "    \"size\": %d,\n"
                  "    \"max_size\": %d,\n"
-                 "    \"processor_status\": \"%s\"\n"
+                 "    \"processor_status\": \"%s\",\n"
+                 "    \"processor_workers\": %d,\n"
+                 "    \"memory_job_bytes\": %zu\n"
+                 "  },\n"
+                 "  \"buffer_pool\": {\n"
+                 "    \"hits\": %lu,\n"
+                 "    \"misses\": %lu,\n"
+                 "    \"releases\": %lu,\n"
+                 "    \"small_allocs\": %lu,\n"
+                 "    \"cached_bytes\": %zu,\n"
+                 "    \"mapped_bytes\": %zu,\n"
+                 "    \"hugepages\": %s\n"
+                 "  },\n"
+                 "  \"request_arena\": {\n"
+                 "    \"requests\": %lu,\n"
+                 "    \"avg_peak_bytes\": %llu,\n"
+                 "    \"max_peak_bytes\": %zu,\n"
+                 "    \"max_reserved_bytes\": %zu\n"
                  "  },\n"
                  "  \"stats\": {\n"
                  "    \"total_uploads\": %d,\n"
@@ -587,7 +1222,13 @@ int handle_get_request(int client_socket, const char *path, const char *client_i
                  "  \"max_file_size_mb\": %d\n"
                  "}",
                  server_config.port, main_server.client_count, server_config.max_connections,
+                 main_server.reactor_count, main_server.sharded_listeners ? "true" : "false",
                  get_queue_size(), MAX_QUEUE_SIZE, processor_running ? "running" : "stopped",
+                 processor_worker_count, get_memory_job_bytes(),
+                 pool_stats.hits, pool_stats.misses, pool_stats.releases, pool_stats.small_allocs,
+                 pool_stats.cached_bytes, pool_stats.mapped_bytes, pool_stats.hugepages ? "true" : "false",
+                 arena_stats.requests, arena_stats.requests ? arena_stats.total_peak / arena_stats.requests : 0ULL,
+                 arena_stats.max_peak, arena_stats.max_reserved,
                  stats->total_uploads, stats->successful_uploads, stats->failed_uploads,
                  stats->total_bytes_processed, server_config.supported_formats,
                  server_config.max_image_size_mb);
@@ -605,7 +1246,7 @@ int handle_get_request(int client_socket, const char *path, const char *client_i
             "  \"supported_formats\": [\"jpg\", \"jpeg\", \"png\", \"gif\"],\n"
             "  \"max_size_mb\": " STR(MAX_IMAGE_SIZE_MB) ",\n"
                                                          "  \"field_name\": \"image\",\n"
-                                                         "  \"processing_note\": \"Files are processed by size - smaller files first\"\n"
+                                                         "  \"processing_note\": \"Files are processed by estimated cost (pixels x channels x format weight) - cheapest first\"\n"
                                                          "}";
 
         send_success_response(client_socket, "application/json", upload_info);
@@ -615,18 +1256,66 @@ int handle_get_request(int client_socket, const char *path, const char *client_i
     else if (strcmp(path, "/queue") == 0)
     {
         // NUEVA RUTA: Información específica de la cola
-        char queue_info[512];
-        snprintf(queue_info, sizeof(queue_info),
-                 "{\n"
-                 "  \"queue_size\": %d,\n"
-                 "  \"max_queue_size\": %d,\n"
-                 "  \"processor_running\": %s,\n"
-                 "  \"queue_full\": %s,\n"
-                 "  \"processing_policy\": \"Smaller files processed first\"\n"
-                 "}",
-                 get_queue_size(), MAX_QUEUE_SIZE,
-                 processor_running ? "true" : "false",
-                 is_queue_full() ? "true" : "false");
+        char queue_info[16384];
+        size_t len = 0;
+        queued_job_info_t jobs[QUEUE_REPORT_MAX_JOBS];
+        uint64_t pending_cost = 0;
+        int job_count = get_queued_jobs(jobs, QUEUE_REPORT_MAX_JOBS, &pending_cost);
+
+        append_json(queue_info, sizeof(queue_info), &len,
+                    "{\n"
+                    "  \"queue_size\": %d,\n"
+                    "  \"max_queue_size\": %d,\n"
+                    "  \"processor_running\": %s,\n"
+                    "  \"queue_full\": %s,\n"
+                    "  \"processing_policy\": \"Shortest job first by estimated cost\",\n"
+                    "  \"cost_model\": {\"formula\": \"width * height * channels * format_weight\", "
+                    "\"weights\": {\"jpeg\": %d, \"png\": %d, \"gif\": %d}, "
+                    "\"fallback_samples_per_byte\": %d},\n"
+                    "  \"pending_cost\": %llu,\n"
+                    "  \"pending_jobs\": [",
+                    get_queue_size(), MAX_QUEUE_SIZE,
+                    processor_running ? "true" : "false",
+                    is_queue_full() ? "true" : "false",
+                    COST_WEIGHT_JPEG, COST_WEIGHT_PNG, COST_WEIGHT_GIF, COST_SAMPLES_PER_BYTE,
+                    (unsigned long long)pending_cost);
+
+        // Jobs pendientes con su costo estimado (orden de heap, no de ejecución)
+        for (int i = 0; i < job_count; i++)
+        {
+            char filename[MAX_FILENAME_SIZE];
+            json_escape_string(jobs[i].filename, filename, sizeof(filename));
+            append_json(queue_info, sizeof(queue_info), &len,
+                        "%s\n    {\"filename\": \"%s\", \"format\": \"%s\", \"width\": %d, "
+                        "\"height\": %d, \"channels\": %d, \"bytes\": %zu, \"cost\": %llu}",
+                        i > 0 ? "," : "", filename, image_format_name(jobs[i].format),
+                        jobs[i].width, jobs[i].height, jobs[i].channels, jobs[i].file_size,
+                        (unsigned long long)jobs[i].cost);
+        }
+        append_json(queue_info, sizeof(queue_info), &len, "%s],\n  \"workers\": [",
+                    job_count > 0 ? "\n  " : "");
+
+        // Estadísticas por worker del pool de procesamiento
+        processor_worker_stats_t worker_stats[MAX_PROCESSOR_WORKERS];
+        int worker_count = get_worker_statistics(worker_stats);
+        for (int i = 0; i < worker_count; i++)
+        {
+            append_json(queue_info, sizeof(queue_info), &len,
+                        "%s\n    {\"id\": %d, \"busy\": %s, \"processed\": %lu, \"failed\": %lu, "
+                        "\"bytes\": %llu, \"busy_seconds\": %.3f}",
+                        i > 0 ? "," : "", i, worker_stats[i].busy ? "true" : "false",
+                        worker_stats[i].files_processed, worker_stats[i].files_failed,
+                        worker_stats[i].bytes_processed, worker_stats[i].busy_seconds);
+        }
+
+        // Un JSON truncado no sirve: mejor un error explícito
+        if (!append_json(queue_info, sizeof(queue_info), &len, "\n  ]\n}"))
+        {
+            LOG_ERROR("Respuesta de /queue excede %zu bytes", sizeof(queue_info));
+            send_error_response(client_socket, 500, "Internal Server Error");
+            log_client_activity(client_ip, path, "GET", "error");
+            return -1;
+        }
 
         send_success_response(client_socket, "application/json", queue_info);
         log_client_activity(client_ip, path, "GET", "success");
@@ -645,7 +1334,7 @@ int handle_get_request(int client_socket, const char *path, const char *client_i
 int send_http_response(int client_socket, int status_code, const char *content_type,
                        const char *content, size_t content_length)
 {
-    char response[MAX_BUFFER_SIZE];
+    char header[MAX_BUFFER_SIZE];
     char *status_text;
 
     switch (status_code)
@@ -662,6 +1351,9 @@ int send_http_response(int client_socket, int status_code, const char *content_t
     case 405:
         status_text = "Method Not Allowed";
         break;
+    case 413:
+        status_text = "Payload Too Large";
+        break;
     case 500:
         status_text = "Internal Server Error";
         break;
@@ -673,7 +1365,7 @@ int send_http_response(int client_socket, int status_code, const char *content_t
         break;
     }
 
-    int header_len = snprintf(response, sizeof(response),
+    int header_len = snprintf(header, sizeof(header),
                               "HTTP/1.1 %d %s\r\n"
                               "Content-Type: %s\r\n"
                               "Content-Length: %zu\r\n"
@@ -682,16 +1374,50 @@ int send_http_response(int client_socket, int status_code, const char *content_t
                               "\r\n",
                               status_code, status_text, content_type, content_length);
 
+    if (!content)
+    {
+        content_length = 0;
+    }
+
+    // Conexión gestionada por un reactor: dejar la respuesta pendiente
+    client_info_t *client = lookup_client(client_socket);
+    if (client)
+    {
+        if (client->response)
+        {
+            LOG_DEBUG("Respuesta ya pendiente para %s, descartando código %d",
+                      client->ip_str, status_code);
+            return 0;
+        }
+
+        char *response = arena_alloc(&client->arena, header_len + content_length);
+        if (!response)
+        {
+            return -1;
+        }
+
+        memcpy(response, header, header_len);
+        if (content_length > 0)
+        {
+            memcpy(response + header_len, content, content_length);
+        }
+
+        client->response = response;
+        client->response_len = header_len + content_length;
+        client->response_sent = 0;
+        return 0;
+    }
+
     // Enviar header
-    if (send(client_socket, response, header_len, 0) < 0)
+    if (send(client_socket, header, header_len, MSG_NOSIGNAL) < 0)
     {
         return -1;
     }
 
     // Enviar contenido si existe
-    if (content && content_length > 0)
+    if (content_length > 0)
     {
-        if (send(client_socket, content, content_length, 0) < 0)
+        if (send(client_socket, content, content_length, MSG_NOSIGNAL) < 0)
         {
             return -1;
         }
@@ -709,7 +1435,7 @@ int parse_http_request(const char *request, char *method, char *path)
     }
 
     // Validar método HTTP
-    if (strcmp(method, "GET") != 0 && strcmp(method, "POST") != 0 &&
+    if (strcmp(method, "GET") != 0 && strcmp(method, "POST") != 0 && strcmp(method, "PUT") != 0 &&
         strcmp(method, "HEAD") != 0 && strcmp(method, "OPTIONS") != 0)
     {
         return -1;
@@ -718,41 +1444,37 @@ int parse_http_request(const char *request, char *method, char *path)
     return 0;
 }
 
-// Limpiar clientes inactivos
-void cleanup_inactive_clients(void)
+// Limpiar clientes inactivos del reactor
+void cleanup_inactive_clients(reactor_t *reactor)
 {
-    pthread_mutex_lock(&main_server.clients_mutex);
-
     time_t current_time = time(NULL);
 
-    for (int i = 0; i < MAX_CLIENTS; i++)
+    while (1)
     {
-        if (main_server.clients[i].active)
-        {
-            // Verificar si el cliente lleva mucho tiempo conectado sin actividad
-            if (difftime(current_time, main_server.clients[i].connection_time) > 300)
-            { // 5 minutos
-                LOG_WARNING("Cliente inactivo detectado: %s (conectado hace %.0f segundos)",
-                            main_server.clients[i].ip_str,
-                            difftime(current_time, main_server.clients[i].connection_time));
-
-                // Cerrar socket si está aún abierto
-                if (main_server.clients[i].socket_fd > 0)
-                {
-                    close(main_server.clients[i].socket_fd);
-                }
+        client_info_t *expired = NULL;
 
-                // Marcar como inactivo
-                main_server.clients[i].active = 0;
-                main_server.client_count--;
+        pthread_mutex_lock(&reactor->completed_mutex);
+        for (client_info_t *client = reactor->connections; client; client = client->next)
+        {
+            // Las conexiones en cola pertenecen al procesador de archivos
+            if (client->state == CONN_WAITING_QUEUE)
+                continue;
 
-                // Hacer join del thread si es posible (no bloqueable)
-                pthread_detach(main_server.clients[i].thread_id);
+            if (difftime(current_time, client->last_activity) > CONNECTION_IDLE_TIMEOUT)
+            {
+                expired = client;
+                break;
             }
         }
-    }
+        pthread_mutex_unlock(&reactor->completed_mutex);
 
-    pthread_mutex_unlock(&main_server.clients_mutex);
+        if (!expired)
+            break;
+
+        LOG_WARNING("Cliente inactivo detectado: %s (sin actividad hace %.0f segundos)",
+                    expired->ip_str, difftime(current_time, expired->last_activity));
+        close_client_connection(expired);
+    }
 }
 
 // Detener servidor
@@ -766,15 +1488,34 @@ int stop_server(void)
     LOG_INFO("Deteniendo servidor TCP...");
     main_server.status = SERVER_STOPPING;
 
+    // Despertar y esperar a los reactores
+    for (int i = 0; i < main_server.reactor_count; i++)
+    {
+        wake_reactor(&main_server.reactors[i]);
+    }
+    for (int i = 0; i < main_server.reactor_count; i++)
+    {
+        pthread_join(main_server.reactors[i].thread, NULL);
+    }
+
+    // Cerrar sockets de escucha
+    for (int i = 0; i < main_server.reactor_count; i++)
+    {
+        reactor_t *reactor = &main_server.reactors[i];
+        if (reactor->listen_fd != -1 && reactor->listen_fd != main_server.server_socket)
+        {
+            close(reactor->listen_fd);
+        }
+        reactor->listen_fd = -1;
+    }
+
     // Cerrar socket principal
     if (main_server.server_socket != -1)
     {
         close(main_server.server_socket);
+        main_server.server_socket = -1;
     }
 
-    // Esperar a que termine el hilo del servidor
-    pthread_join(main_server.server_thread, NULL);
-
     // Mostrar estadísticas finales
     log_file_stats();
 
@@ -793,19 +1534,39 @@ void cleanup_server(void)
     stop_file_processor();
     destroy_priority_queue();
 
-    // Cerrar todas las conexiones de clientes
-    pthread_mutex_lock(&main_server.clients_mutex);
-    for (int i = 0; i < MAX_CLIENTS; i++)
+    if (main_server.server_socket != -1)
     {
-        if (main_server.clients[i].active)
+        close(main_server.server_socket);
+        main_server.server_socket = -1;
+    }
+
+    // Cerrar todas las conexiones de clientes y los reactores
+    for (int i = 0; i < main_server.reactor_count; i++)
+    {
+        reactor_t *reactor = &main_server.reactors[i];
+
+        while (reactor->connections)
         {
-            close(main_server.clients[i].socket_fd);
-            main_server.clients[i].active = 0;
+            close_client_connection(reactor->connections);
         }
+        reactor->completed = NULL;
+
+        if (reactor->listen_fd > 0 && reactor->listen_fd != main_server.server_socket)
+            close(reactor->listen_fd);
+        if (reactor->epoll_fd > 0)
+            close(reactor->epoll_fd);
+        if (reactor->event_fd > 0)
+            close(reactor->event_fd);
+        reactor->listen_fd = -1;
+        reactor->epoll_fd = -1;
+        reactor->event_fd = -1;
+        pthread_mutex_destroy(&reactor->completed_mutex);
     }
-    pthread_mutex_unlock(&main_server.clients_mutex);
+    main_server.reactor_count = 0;
 
-    // Destruir mutex
+    // Destruir tabla y mutex
+    free(main_server.clients);
+    main_server.clients = NULL;
     pthread_mutex_destroy(&main_server.clients_mutex);
 
     main_server.status = SERVER_STOPPED;
@@ -0,0 +1,223 @@
+#include "thread_pool.h"
+#include "logger.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sched.h>
+
+// Un parallel_for en curso; vive en el stack del llamador
+typedef struct parallel_job
+{
+    parallel_task_fn fn;
+    void *ctx;
+    int count;
+    int next_index; // Próximo índice a reclamar (atómico)
+    int completed;  // Tareas terminadas (atómico)
+    int attached;   // Hilos del pool trabajando en este job (protegido por mutex)
+    struct parallel_job *next;
+} parallel_job_t;
+
+typedef struct
+{
+    pthread_t threads[MAX_COMPUTE_THREADS];
+    int thread_count;
+    int cpu_count; // CPUs en los que puede correr el proceso (afinidad)
+    int running;
+    parallel_job_t *jobs; // Jobs con índices pendientes
+    pthread_mutex_t mutex;
+    pthread_cond_t work_available;
+    pthread_cond_t job_finished;
+} compute_pool_t;
+
+static compute_pool_t compute_pool = {
+    .thread_count = 0,
+    .cpu_count = 1,
+    .running = 0,
+    .jobs = NULL,
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .work_available = PTHREAD_COND_INITIALIZER,
+    .job_finished = PTHREAD_COND_INITIALIZER};
+
+// Quitar un job de la lista de pendientes (con mutex tomado)
+static void detach_job(parallel_job_t *job)
+{
+    parallel_job_t **link = &compute_pool.jobs;
+    while (*link)
+    {
+        if (*link == job)
+        {
+            *link = job->next;
+            return;
+        }
+        link = &(*link)->next;
+    }
+}
+
+// Reclamar y ejecutar índices del job hasta agotarlos
+static void run_job_tasks(parallel_job_t *job)
+{
+    while (1)
+    {
+        int index = __atomic_fetch_add(&job->next_index, 1, __ATOMIC_RELAXED);
+        if (index >= job->count)
+            break;
+
+        job->fn(job->ctx, index);
+        __atomic_fetch_add(&job->completed, 1, __ATOMIC_RELEASE);
+    }
+}
+
+// CPUs disponibles para el proceso: la afinidad puede ser menor que los CPUs en línea
+static int available_cpus(void)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0 && CPU_COUNT(&set) > 0)
+        return CPU_COUNT(&set);
+
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return cpus > 0 ? (int)cpus : 1;
+}
+
+static void *compute_thread_func(void *arg)
+{
+    (void)arg;
+
+    pthread_mutex_lock(&compute_pool.mutex);
+    while (compute_pool.running)
+    {
+        parallel_job_t *job = compute_pool.jobs;
+        if (!job)
+        {
+            pthread_cond_wait(&compute_pool.work_available, &compute_pool.mutex);
+            continue;
+        }
+
+        job->attached++;
+        pthread_mutex_unlock(&compute_pool.mutex);
+
+        run_job_tasks(job);
+
+        pthread_mutex_lock(&compute_pool.mutex);
+        // Índices agotados: ningún otro hilo debe engancharse a este job
+        detach_job(job);
+        job->attached--;
+        pthread_cond_broadcast(&compute_pool.job_finished);
+    }
+    pthread_mutex_unlock(&compute_pool.mutex);
+
+    return NULL;
+}
+
+int thread_pool_init(int thread_count)
+{
+    if (compute_pool.running)
+    {
+        LOG_WARNING("El pool de cómputo ya está iniciado");
+        return 1;
+    }
+
+    if (thread_count <= 0)
+    {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        thread_count = cpus > 0 ? (int)cpus : 1;
+    }
+    if (thread_count > MAX_COMPUTE_THREADS)
+        thread_count = MAX_COMPUTE_THREADS;
+
+    compute_pool.cpu_count = available_cpus();
+    compute_pool.running = 1;
+    compute_pool.jobs = NULL;
+    compute_pool.thread_count = 0;
+
+    for (int i = 0; i < thread_count; i++)
+    {
+        if (pthread_create(&compute_pool.threads[i], NULL, compute_thread_func, NULL) != 0)
+        {
+            LOG_ERROR("Error creando hilo de cómputo %d: %s", i, strerror(errno));
+            break;
+        }
+        compute_pool.thread_count++;
+    }
+
+    if (compute_pool.thread_count == 0)
+    {
+        compute_pool.running = 0;
+        return 0;
+    }
+
+    LOG_INFO("Pool de cómputo iniciado con %d hilos (%d CPUs disponibles)", compute_pool.thread_count,
+             compute_pool.cpu_count);
+    return 1;
+}
+
+void thread_pool_destroy(void)
+{
+    if (!compute_pool.running)
+        return;
+
+    pthread_mutex_lock(&compute_pool.mutex);
+    compute_pool.running = 0;
+    pthread_cond_broadcast(&compute_pool.work_available);
+    pthread_mutex_unlock(&compute_pool.mutex);
+
+    for (int i = 0; i < compute_pool.thread_count; i++)
+    {
+        pthread_join(compute_pool.threads[i], NULL);
+    }
+    compute_pool.thread_count = 0;
+
+    LOG_INFO("Pool de cómputo detenido");
+}
+
+int thread_pool_concurrency(void)
+{
+    if (!compute_pool.running)
+        return 1;
+
+    // Más hilos que CPUs no agregan paralelismo real
+    int threads = compute_pool.thread_count + 1;
+    return threads < compute_pool.cpu_count ? threads : compute_pool.cpu_count;
+}
+
+void parallel_for(int count, parallel_task_fn fn, void *ctx)
+{
+    if (count <= 0)
+        return;
+
+    // Sin pool o una sola tarea: ejecutar en el hilo actual
+    if (!compute_pool.running || count == 1)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            fn(ctx, i);
+        }
+        return;
+    }
+
+    parallel_job_t job;
+    memset(&job, 0, sizeof(job));
+    job.fn = fn;
+    job.ctx = ctx;
+    job.count = count;
+
+    pthread_mutex_lock(&compute_pool.mutex);
+    job.next = compute_pool.jobs;
+    compute_pool.jobs = &job;
+    pthread_cond_broadcast(&compute_pool.work_available);
+    pthread_mutex_unlock(&compute_pool.mutex);
+
+    // El llamador también ejecuta tareas
+    run_job_tasks(&job);
+
+    // Esperar a que terminen las tareas reclamadas por el pool y que ningún
+    // hilo siga referenciando el job antes de liberar el stack
+    pthread_mutex_lock(&compute_pool.mutex);
+    detach_job(&job);
+    while (job.attached > 0 || __atomic_load_n(&job.completed, __ATOMIC_ACQUIRE) < count)
+    {
+        pthread_cond_wait(&compute_pool.job_finished, &compute_pool.mutex);
+    }
+    pthread_mutex_unlock(&compute_pool.mutex);
+}